@@ -0,0 +1,77 @@
+/*
+heap.cpp
+--------
+Replaces the global allocation functions of the bench, so each scenario's
+memory can be told apart from the others'. A separate translation unit, so
+the compiler never sees `operator new` & `operator delete` inlined together.
+*/
+
+#include "heap.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/* bytes currently allocated through `operator new`, & their high water mark */
+static std::atomic<usize> sHeapBytes{0};
+static std::atomic<usize> sHeapPeak{0};
+
+/* leaves room for the size in front of each block without breaking the
+   alignment `operator new` guarantees */
+static constexpr usize cHeapHeader = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void *operator new(std::size_t size) {
+  auto *block = static_cast<char*>(std::malloc(cHeapHeader + size));
+  if(block == nullptr) {
+    throw std::bad_alloc{};
+  }
+  std::memcpy(block, &size, sizeof(size));
+  usize now = sHeapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  usize peak = sHeapPeak.load(std::memory_order_relaxed);
+  while(now > peak
+  && !sHeapPeak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+  return block + cHeapHeader;
+}
+
+void operator delete(void *ptr) noexcept {
+  if(ptr == nullptr) {
+    return;
+  }
+  auto *block = static_cast<char*>(ptr) - cHeapHeader;
+  std::size_t size = 0;
+  std::memcpy(&size, block, sizeof(size));
+  sHeapBytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(block);
+}
+
+void *operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void operator delete[](void *ptr) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  ::operator delete(ptr);
+}
+
+namespace heap {
+
+usize current() {
+  return sHeapBytes.load(std::memory_order_relaxed);
+}
+
+usize peak() {
+  return sHeapPeak.load(std::memory_order_relaxed);
+}
+
+void resetPeak() {
+  sHeapPeak.store(current(), std::memory_order_relaxed);
+}
+
+} // namespace heap
@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+heap.hpp
+--------
+Heap usage as counted by the bench's replacement `operator new`
+*/
+
+#include <nwge/common/def.h>
+
+namespace heap {
+
+/* Bytes currently allocated through `operator new`. */
+usize current();
+/* The most allocated at once since the last `resetPeak`. */
+usize peak();
+/* Starts a new high water mark at what is allocated right now. */
+void resetPeak();
+
+} // namespace heap
@@ -0,0 +1,439 @@
+#include "../sbs/BrickField.hpp"
+#include "../sbs/config.hpp"
+#include "../sbs/perf.hpp"
+#include "../sbs/Sim.hpp"
+#include "heap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <nwge/common/array.hpp>
+#include <nwge/json.hpp>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+bench
+-----
+Scripted benchmarks of the CPU side of each screen. Every scenario runs a
+fixed number of frames at a fixed delta from a fixed seed, then the results
+are written as JSON & compared against a baseline. The JSON goes to a file
+since loading a plain JSON config dumps it to the console.
+
+  bench [options] [cfg.json]
+
+  --frames N          override the frame count of every scenario
+  --out FILE          where to write the results (default bench.json)
+  --only NAME         run the scenarios whose name starts with NAME
+  --baseline FILE     compare against FILE (default source/bench/baseline.json)
+  --tolerance F       allowed slowdown over the baseline (default 0.25)
+  --write-baseline    write the results to the baseline file instead, with
+                      --only the other scenarios of the baseline are kept
+
+Exits with 2 when a scenario regressed, and with 3 when there is no usable
+baseline, so a missing one never passes for a clean run. Run it on the
+machine the baseline was recorded on, the numbers mean nothing anywhere
+else.
+
+Memory is the peak heap growth of each scenario on its own, counted by the
+replaced global `operator new` in heap.cpp, since the process-wide peak RSS only
+ever reports the largest scenario run so far. Whatever is allocated with
+`malloc` directly is not counted.
+*/
+
+using namespace nwge;
+using sbs::BrickField;
+using sbs::Config;
+using sbs::Rng;
+using sbs::SavefileV3;
+using sbs::Sim;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr f32 cDelta = 1.0f / 60.0f;
+
+struct Options {
+  u32 frames = 0;
+  const char *only = "";
+  const char *out = "bench.json";
+  const char *baseline = "source/bench/baseline.json";
+  f64 tolerance = 0.25;
+  bool writeBaseline = false;
+  const char *config = "source/data/cfg.json";
+};
+
+/*
+`setup` runs once & counts as the load time, `frame` runs once per frame.
+Everything a scenario needs lives in the closures, so its memory is only
+allocated while it runs.
+*/
+struct Scenario {
+  std::string name;
+  u32 frames;
+  std::function<std::function<void()>()> setup;
+};
+
+struct Result {
+  std::string name;
+  u32 frames = 0;
+  f64 loadUs = 0;
+  f64 p50 = 0;
+  f64 p95 = 0;
+  f64 p99 = 0;
+  f64 max = 0;
+  /* peak heap growth while the scenario ran */
+  s64 peakHeapKb = 0;
+};
+
+std::string readFile(const char *path) {
+  std::ifstream file{path, std::ios::binary};
+  if(!file) {
+    return {};
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+bool parseOptions(s32 argc, CStr *argv, Options &out) {
+  for(s32 i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto want = [&](const char *name) {
+      if(std::strcmp(arg, name) != 0) {
+        return false;
+      }
+      if(value == nullptr) {
+        std::fprintf(stderr, "%s expects a value\n", name);
+        std::exit(1);
+      }
+      ++i;
+      return true;
+    };
+    if(want("--frames")) {
+      out.frames = u32(std::strtoul(value, nullptr, 10));
+    } else if(want("--out")) {
+      out.out = value;
+    } else if(want("--only")) {
+      out.only = value;
+    } else if(want("--baseline")) {
+      out.baseline = value;
+    } else if(want("--tolerance")) {
+      out.tolerance = std::strtod(value, nullptr);
+    } else if(std::strcmp(arg, "--write-baseline") == 0) {
+      out.writeBaseline = true;
+    } else if(arg[0] == '-') {
+      std::fprintf(stderr, "unknown option %s\n", arg);
+      return false;
+    } else {
+      out.config = arg;
+    }
+  }
+  return true;
+}
+
+/* The brick fields of the menu, the extras & the void at its usual sizes. */
+void addBrickScenarios(std::vector<Scenario> &out) {
+  struct Field {
+    const char *name;
+    BrickField::Params params;
+  };
+  static const Field cFields[] = {
+    {"menu.bricks", {.count = 100, .speed = 0.1f, .width = 0.04f, .height = 0.08f,
+      .baseZ = 0.53f, .deStretch = BrickField::DeStretchPos}},
+    {"extras.bricks", {.count = 50, .speed = 0.1f, .width = 0.04f, .height = 0.08f,
+      .baseZ = 0.7f}},
+    {"void.bricks.1000", {.count = 1000, .speed = 0.2f, .width = 0.08f, .height = 0.16f,
+      .baseZ = 0.53f, .deStretch = BrickField::DeStretchSize}},
+    {"void.bricks.10000", {.count = 10000, .speed = 0.2f, .width = 0.08f, .height = 0.16f,
+      .baseZ = 0.53f, .deStretch = BrickField::DeStretchSize}},
+    {"void.bricks.100000", {.count = 100000, .speed = 0.2f, .width = 0.08f, .height = 0.16f,
+      .baseZ = 0.53f, .deStretch = BrickField::DeStretchSize}},
+  };
+  for(const auto &field: cFields) {
+    out.push_back({field.name, 600, [params = field.params]{
+      auto bricks = std::make_shared<BrickField>(params);
+      bricks->reseed(0x5B5);
+      return [bricks]{
+        bricks->update(cDelta);
+      };
+    }});
+  }
+}
+
+/* A player halfway through the upgrades, clicking 8 times a second. */
+void addSimScenario(std::vector<Scenario> &out, const std::string &raw) {
+  out.push_back({"shit.midgame", 3600, [&raw]{
+    struct Game {
+      Config config;
+      SavefileV3 save;
+      Sim sim{0x5B5202A};
+      Rng player{0x5B5202B};
+      f32 nextClick = 0.0f;
+    };
+    auto state = std::make_shared<Game>();
+    if(!state->config.loadMemory(StringView{raw.data(), raw.size()})) {
+      std::fprintf(stderr, "could not load the config\n");
+      std::exit(1);
+    }
+    state->save.lubeTier = 3;
+    state->save.gravityTier = 2;
+    state->save.oxyTier = 1;
+    state->save.score = 500;
+    state->sim.recalculate(state->config, state->save);
+    return [state]{
+      state->nextClick -= cDelta;
+      if(state->nextClick <= 0) {
+        state->sim.push(state->config);
+        state->nextClick += 0.125f * (0.5f + state->player.unit());
+      }
+      state->sim.advance(cDelta, state->config, state->save);
+    };
+  }});
+}
+
+/* Parsing cfg.json, the only load the menu & the game do on the CPU. */
+void addConfigScenario(std::vector<Scenario> &out, const std::string &raw) {
+  out.push_back({"config.parse", 100, [&raw]{
+    return [&raw]{
+      Config config;
+      config.loadMemory(StringView{raw.data(), raw.size()});
+    };
+  }});
+}
+
+/* What a thousand timers cost per frame, which should stay negligible. */
+void addPerfScenario(std::vector<Scenario> &out) {
+  out.push_back({"perf.scopes", 600, []{
+    return []{
+      for(s32 i = 0; i < 1000; ++i) {
+        SBS_PERF_SCOPE("bench.scope");
+      }
+    };
+  }});
+}
+
+Result run(const Scenario &scenario, u32 frames) {
+  Result result;
+  result.name = scenario.name;
+  result.frames = frames;
+  // allocated up front, so the timings stay out of the scenario's figure
+  std::vector<f64> times;
+  times.reserve(frames);
+  usize heapBefore = heap::current();
+  heap::resetPeak();
+
+  auto start = Clock::now();
+  auto frame = scenario.setup();
+  result.loadUs = std::chrono::duration<f64, std::micro>(Clock::now() - start).count();
+
+  for(u32 i = 0; i < frames; ++i) {
+    auto frameStart = Clock::now();
+    frame();
+    times.push_back(std::chrono::duration<f64, std::micro>(Clock::now() - frameStart).count());
+  }
+  std::sort(times.begin(), times.end());
+  auto at = [&](f64 pct) {
+    if(times.empty()) {
+      return 0.0;
+    }
+    return times[std::min(times.size() - 1, usize(pct * f64(times.size())))];
+  };
+  result.p50 = at(0.50);
+  result.p95 = at(0.95);
+  result.p99 = at(0.99);
+  result.max = times.empty() ? 0.0 : times.back();
+  result.peakHeapKb = s64((heap::peak() - heapBefore) / 1024);
+  return result;
+}
+
+std::string toJSON(const std::vector<Result> &results) {
+  std::string out = "{\n  \"scenarios\": [\n";
+  char line[512];
+  for(usize i = 0; i < results.size(); ++i) {
+    const auto &res = results[i];
+    std::snprintf(line, sizeof(line),
+      "    {\"name\": \"%s\", \"frames\": %u, \"loadUs\": %.1f, "
+      "\"frameUs\": {\"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f, \"max\": %.2f}, "
+      "\"peakHeapKb\": %lld}%s\n",
+      res.name.c_str(), res.frames, res.loadUs,
+      res.p50, res.p95, res.p99, res.max,
+      (long long)res.peakHeapKb, i + 1 < results.size() ? "," : "");
+    out += line;
+  }
+  out += "  ]\n}\n";
+  return out;
+}
+
+/*
+Reads the scenarios of a baseline written by toJSON. Returns false when the
+file is missing or is not a baseline. Figures the file does not have are left
+at 0, which compare skips.
+*/
+bool readBaseline(const char *path, std::vector<Result> &out) {
+  auto raw = readFile(path);
+  if(raw.empty()) {
+    return false;
+  }
+  Array<char> storage{raw.size()};
+  std::memcpy(&storage[0], raw.data(), raw.size());
+  auto res = json::parse(storage.view());
+  if(res.error != json::OK || !res.value->isObject()) {
+    return false;
+  }
+  const auto *scenariosV = res.value->object().get("scenarios");
+  if(scenariosV == nullptr || !scenariosV->isArray()) {
+    return false;
+  }
+
+  auto number = [](const json::Object &obj, const char *key) {
+    const auto *valueV = obj.get(key);
+    return valueV != nullptr && valueV->isNumber() ? valueV->number() : 0.0;
+  };
+  for(const auto &scenarioV: scenariosV->array()) {
+    if(!scenarioV.isObject()) {
+      continue;
+    }
+    const auto &scenario = scenarioV.object();
+    const auto *nameV = scenario.get("name");
+    if(nameV == nullptr || !nameV->isString()) {
+      continue;
+    }
+    Result result;
+    auto name = nameV->string();
+    result.name.assign(name.begin(), name.size());
+    result.frames = u32(number(scenario, "frames"));
+    result.loadUs = number(scenario, "loadUs");
+    const auto *frameV = scenario.get("frameUs");
+    if(frameV != nullptr && frameV->isObject()) {
+      result.p50 = number(frameV->object(), "p50");
+      result.p95 = number(frameV->object(), "p95");
+      result.p99 = number(frameV->object(), "p99");
+      result.max = number(frameV->object(), "max");
+    }
+    result.peakHeapKb = s64(number(scenario, "peakHeapKb"));
+    out.push_back(std::move(result));
+  }
+  return true;
+}
+
+/*
+The baseline with the scenarios that just ran replaced, so recording a
+subset with --only keeps the figures of every other scenario.
+*/
+std::vector<Result> mergeBaseline(const std::vector<Result> &results, const Options &opts) {
+  std::vector<Result> merged;
+  readBaseline(opts.baseline, merged);
+  for(const auto &result: results) {
+    auto found = std::find_if(merged.begin(), merged.end(), [&](const Result &base) {
+      return base.name == result.name;
+    });
+    if(found != merged.end()) {
+      *found = result;
+    } else {
+      merged.push_back(result);
+    }
+  }
+  return merged;
+}
+
+/* Returns the number of regressions, or -1 when there is no baseline. */
+s32 compare(const std::vector<Result> &results, const Options &opts) {
+  std::vector<Result> baseline;
+  if(!readBaseline(opts.baseline, baseline)) {
+    std::fprintf(stderr, "no usable baseline at %s, record one with --write-baseline\n", opts.baseline);
+    return -1;
+  }
+
+  s32 regressions = 0;
+  for(const auto &result: results) {
+    auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result &entry) {
+      return entry.name == result.name;
+    });
+    if(base == baseline.end()) {
+      std::fprintf(stderr, "%-20s not in the baseline\n", result.name.c_str());
+      continue;
+    }
+
+    auto check = [&](const char *metric, f64 now, f64 then) {
+      // sub-microsecond figures are all noise
+      if(then <= 0.0 || now <= 1.0 || now <= then * (1.0 + opts.tolerance)) {
+        return;
+      }
+      std::fprintf(stderr, "%-20s %s regressed: %.2f us, baseline %.2f us (+%.0f%%)\n",
+        result.name.c_str(), metric, now, then, (now / then - 1.0) * 100.0);
+      ++regressions;
+    };
+    check("load", result.loadUs, base->loadUs);
+    check("frame p50", result.p50, base->p50);
+    check("frame p95", result.p95, base->p95);
+  }
+  return regressions;
+}
+
+} // namespace
+
+s32 main(s32 argc, CStr *argv) {
+  Options opts;
+  if(!parseOptions(argc, argv, opts)) {
+    return 1;
+  }
+
+  auto raw = readFile(opts.config);
+  if(raw.empty()) {
+    std::fprintf(stderr, "could not read %s\n", opts.config);
+    return 1;
+  }
+
+  std::vector<Scenario> scenarios;
+  addConfigScenario(scenarios, raw);
+  addSimScenario(scenarios, raw);
+  addBrickScenarios(scenarios);
+  addPerfScenario(scenarios);
+
+  std::vector<Result> results;
+  for(const auto &scenario: scenarios) {
+    if(scenario.name.rfind(opts.only, 0) != 0) {
+      continue;
+    }
+    u32 frames = opts.frames != 0 ? opts.frames : scenario.frames;
+    std::fprintf(stderr, "%s: %u frames\n", scenario.name.c_str(), frames);
+    results.push_back(run(scenario, frames));
+  }
+
+  for(const auto &res: results) {
+    std::fprintf(stderr, "%-20s load %10.1f us, frame p50 %8.2f p95 %8.2f p99 %8.2f max %8.2f us, heap peak %lld KiB\n",
+      res.name.c_str(), res.loadUs, res.p50, res.p95, res.p99, res.max, (long long)res.peakHeapKb);
+  }
+
+  const char *outPath = opts.writeBaseline ? opts.baseline : opts.out;
+  // read before the ofstream truncates it
+  auto written = toJSON(opts.writeBaseline ? mergeBaseline(results, opts) : results);
+  std::ofstream file{outPath, std::ios::binary};
+  if(!file || !(file << written)) {
+    std::fprintf(stderr, "could not write %s\n", outPath);
+    return 1;
+  }
+  std::fprintf(stderr, "wrote %s\n", outPath);
+  if(opts.writeBaseline) {
+    return 0;
+  }
+
+  s32 regressions = compare(results, opts);
+  if(regressions < 0) {
+    return 3;
+  }
+  if(regressions > 0) {
+    std::fprintf(stderr, "%d regressions\n", regressions);
+    return 2;
+  }
+  return 0;
+}
@@ -1,9 +1,17 @@
 """Plugin to automatically pack bundles"""
 
 import bip
+import hashlib
+import json
+import shutil
+import struct
+import zlib
 
 g_src: bip.Path
 g_out: bip.Path
+g_stage: bip.Path
+g_hashes: bip.Path
+g_max_texture_size: int | None
 
 def configure(settings: dict) -> bool:
   if "src" not in settings:
@@ -18,10 +26,23 @@ def configure(settings: dict) -> bool:
 
   global g_src
   global g_out
+  global g_stage
+  global g_hashes
+  global g_max_texture_size
   global g_exe
 
   g_src = bip.Path(settings["src"]).resolve()
   g_out = bip.Path(settings["out"]).resolve()
+  g_stage = g_out.with_suffix(".stage")
+  # next to the stage, not in it, or it would end up in the bundle
+  g_hashes = g_out.with_suffix(".hashes.json")
+
+  g_max_texture_size = settings.get("max-texture-size")
+  if g_max_texture_size is not None and (
+      not isinstance(g_max_texture_size, int) or g_max_texture_size < 1):
+    bip.err("`max-texture-size` must be a positive integer.",
+            "Remove it to keep textures at their original size.")
+    return False
 
   if not g_out.parent.exists():
     g_out.parent.mkdir(parents=True)
@@ -36,21 +57,808 @@ def configure(settings: dict) -> bool:
 def clean() -> bool:
   if g_out.exists():
     g_out.unlink()
+  if g_stage.exists():
+    shutil.rmtree(g_stage)
+  if g_hashes.exists():
+    g_hashes.unlink()
   return True
 
 def want_run() -> bool:
-  if not g_out.exists():
+  if not g_out.exists() or not g_stage.exists():
     return True
 
-  bndlmt = g_out.stat().st_mtime
-  for bndlfile in g_src.iterdir():
-    filemt = bndlfile.stat().st_mtime
-    if filemt > bndlmt:
-      return True
-  return False
+  manifest = load_manifest()
+  return plan(manifest)[0] != manifest["entries"]
 
 def run() -> bool:
-  if not bip.cmd("nwgebndl", ["create", f"{g_src}", f"{g_out}"]):
+  if not stage():
+    return False
+
+  if not bip.cmd("nwgebndl", ["create", f"{g_stage}", f"{g_out}"]):
+    return False
+
+  return True
+
+# Incremental staging. Every entry is staged by a job, identified by a hash
+# of everything its output depends on: the source bytes, the [data] settings
+# and this very file. The hashes of the last run are kept in g_hashes along
+# with the stat of each source, so unchanged files are not even re-read, and
+# only jobs whose hash moved are staged again.
+
+MANIFEST_VERSION = 1
+# staged files which are not named after a source belong to this job
+ATLAS_JOB = "<atlas>"
+
+def sources() -> list[bip.Path]:
+  """Files of the source directory which go into the bundle. Names starting
+  with an underscore are authoring files (layered images, uncut audio) the
+  game never loads."""
+  return sorted(path for path in g_src.iterdir()
+                if path.is_file() and not path.name.startswith("_"))
+
+def load_manifest() -> dict:
+  try:
+    manifest = json.loads(g_hashes.read_text(encoding="utf-8"))
+  except (OSError, ValueError):
+    manifest = None
+  if not isinstance(manifest, dict) or manifest.get("version") != MANIFEST_VERSION:
+    manifest = {"version": MANIFEST_VERSION, "files": {}, "entries": {}}
+  return manifest
+
+def hash_file(path: bip.Path, known: dict, files: dict) -> str:
+  info = path.stat()
+  old = known.get(path.name)
+  if (isinstance(old, dict) and old.get("size") == info.st_size
+      and old.get("mtime") == info.st_mtime_ns):
+    digest = old["sha256"]
+  else:
+    digest = hashlib.sha256(path.read_bytes()).hexdigest()
+  files[path.name] = {"size": info.st_size, "mtime": info.st_mtime_ns,
+                      "sha256": digest}
+  return digest
+
+def plan(manifest: dict) -> tuple[dict, dict]:
+  """Hashes every job. Returns the hashes by job & the file stats to keep for
+  the next run."""
+  settings = hashlib.sha256(bip.Path(__file__).read_bytes())
+  settings.update(repr(g_max_texture_size).encode())
+  atlas = settings.copy()
+  entries = {}
+  files = {}
+  for path in sources():
+    digest = hash_file(path, manifest["files"], files)
+    job = settings.copy()
+    job.update(digest.encode())
+    entries[path.name] = job.hexdigest()
+    if path.name in ATLAS_SPRITES or path.suffix.lower() == ".gif":
+      atlas.update(f"{path.name}:{digest};".encode())
+  entries[ATLAS_JOB] = atlas.hexdigest()
+  return entries, files
+
+def stage() -> bool:
+  """Brings the staging directory up to date with the bundle sources,
+  compiling the entries the game has a faster format for along the way."""
+
+  manifest = load_manifest()
+  entries, files = plan(manifest)
+  old = manifest["entries"]
+  g_stage.mkdir(parents=True, exist_ok=True)
+  names = {path.name for path in sources()}
+
+  # anything staged for a source which is gone (or now ignored) goes too
+  stale = [path for path in g_stage.iterdir()
+           if path.name in old and path.name not in names]
+  if old.get(ATLAS_JOB) != entries[ATLAS_JOB]:
+    stale += [path for path in g_stage.iterdir() if path.name not in old]
+  for path in stale:
+    path.unlink()
+
+  done = {}
+  if old.get(ATLAS_JOB) != entries[ATLAS_JOB] or not (g_stage / "atlas.json").exists():
+    if not pack_atlas(g_src, g_stage):
+      return False
+  done[ATLAS_JOB] = entries[ATLAS_JOB]
+
+  for srcfile in sources():
+    name = srcfile.name
+    if old.get(name) == entries[name] and (g_stage / name).exists():
+      done[name] = entries[name]
+      continue
+    if not stage_entry(srcfile):
+      # whatever is done so far is kept for the next attempt
+      save_manifest(files, done)
+      return False
+    done[name] = entries[name]
+
+  save_manifest(files, done)
+  record_texture_sizes(g_stage)
+  return True
+
+def save_manifest(files: dict, entries: dict):
+  manifest = {"version": MANIFEST_VERSION, "files": files, "entries": entries}
+  g_hashes.write_text(json.dumps(manifest, indent=1), encoding="utf-8")
+
+def stage_entry(srcfile: bip.Path) -> bool:
+  if srcfile.name == "cfg.json":
+    compiled = compile_config(srcfile)
+    if compiled is None:
+      return False
+    # the game tells the two formats apart by the magic, so the entry keeps
+    # its name and modded bundles can still ship plain JSON
+    (g_stage / srcfile.name).write_bytes(compiled)
+    return True
+  if g_max_texture_size is not None and srcfile.suffix == ".png":
+    return stage_texture(srcfile, g_stage / srcfile.name, g_max_texture_size)
+  shutil.copy2(srcfile, g_stage / srcfile.name)
+  return True
+
+# Compiled config. See `loadBinary` in source/sbs/config.cpp for the layout.
+
+CONFIG_MAGIC = b"SBSC"
+CONFIG_VERSION = 1
+
+CONFIG_FIXED = [
+  ("lube", [("base", "f"), ("upgrade", "f"), ("maxTier", "t")]),
+  ("gravity", [("base", "f"), ("upgrade", "f"), ("threshold", "f"),
+               ("maxTier", "t")]),
+  ("oxy", [("regenFast", "f"), ("regenSlow", "f"), ("drain", "f"),
+           ("min", "f"), ("cooldown", "f")]),
+  ("toilet", [("xPos", "f"), ("yPos", "f"), ("size", "f")]),
+  ("shitter", [("xPos", "f"), ("yPos", "f"), ("width", "f"),
+               ("height", "f")]),
+  ("brick", [("xPos", "f"), ("startY", "f"), ("endY", "f"),
+             ("fallSpeed", "f"), ("size", "f")]),
+  ("water", [("minX", "f"), ("maxX", "f"), ("minY", "f"), ("maxY", "f"),
+             ("width", "f"), ("height", "f"), ("scissorX", "f"),
+             ("scissorY", "f"), ("scissorW", "f"), ("scissorH", "f")]),
+]
+
+STORE_KINDS = [("lubeTier", 1), ("gravityTier", 2), ("oxyTier", 3),
+               ("endGame", 4)]
+
+S16_MIN = -0x8000
+S16_MAX = 0x7FFF
+S32_MIN = -0x80000000
+S32_MAX = 0x7FFFFFFF
+
+class ConfigError(Exception):
+  pass
+
+def expect_number(obj: dict, key: str, where: str) -> float:
+  if key not in obj:
+    raise ConfigError(f"No `{key}` key in {where}.")
+  value = obj[key]
+  if isinstance(value, bool) or not isinstance(value, (int, float)):
+    raise ConfigError(f"`{key}` in {where} is not a number.")
+  return float(value)
+
+def expect_s16(obj: dict, key: str, where: str) -> int:
+  value = expect_number(obj, key, where)
+  if value != int(value) or not S16_MIN <= value <= S16_MAX:
+    raise ConfigError(f"`{key}` in {where} is not a 16-bit integer.")
+  return int(value)
+
+def expect_s32(obj: dict, key: str, where: str) -> int:
+  value = expect_number(obj, key, where)
+  if value != int(value) or not S32_MIN <= value <= S32_MAX:
+    raise ConfigError(f"`{key}` in {where} is not a 32-bit integer.")
+  return int(value)
+
+def expect_string(obj: dict, key: str, where: str) -> str:
+  if key not in obj:
+    raise ConfigError(f"No `{key}` key in {where}.")
+  if not isinstance(obj[key], str):
+    raise ConfigError(f"`{key}` in {where} is not a string.")
+  return obj[key]
+
+def expect_object(obj: dict, key: str, where: str) -> dict:
+  if key not in obj:
+    raise ConfigError(f"No `{key}` key in {where}.")
+  if not isinstance(obj[key], dict):
+    raise ConfigError(f"`{key}` in {where} is not an object.")
+  return obj[key]
+
+class StringTable:
+  def __init__(self):
+    self.data = bytearray()
+
+  def add(self, value: str) -> bytes:
+    encoded = value.encode("utf-8")
+    ref = struct.pack("<II", len(self.data), len(encoded))
+    self.data += encoded
+    return ref
+
+def compile_config(path: bip.Path) -> bytes | None:
+  try:
+    root = json.loads(path.read_text(encoding="utf-8"))
+    if not isinstance(root, dict):
+      raise ConfigError("Not an object.")
+    return pack_config(root)
+  except json.JSONDecodeError as e:
+    bip.err(f"`{path}` is not valid JSON: {e}",
+             "Fix the syntax error.")
+  except ConfigError as e:
+    bip.err(f"`{path}` is invalid: {e}",
+             "Fix the config before building the bundle.")
+  return None
+
+def pack_config(root: dict) -> bytes:
+  strings = StringTable()
+  fixed = bytearray()
+
+  for section, fields in CONFIG_FIXED:
+    obj = expect_object(root, section, "the config")
+    where = f"the `{section}` object"
+    for field, kind in fields:
+      if kind == "t":
+        fixed += struct.pack("<hxx", expect_s16(obj, field, where))
+      else:
+        fixed += struct.pack("<f", expect_number(obj, field, where))
+
+  socials = expect_object(root, "socials", "the config")
+  fixed += strings.add(expect_string(socials, "x.com", "the `socials` object"))
+  fixed += strings.add(expect_string(socials, "discord", "the `socials` object"))
+
+  if "store" not in root or not isinstance(root["store"], list):
+    raise ConfigError("`store` is not an array.")
+  store = bytearray()
+  for idx, item in enumerate(root["store"]):
+    where = f"`store` element {idx}"
+    if not isinstance(item, dict):
+      raise ConfigError(f"{where} is not an object.")
+    kinds = [(key, kind) for key, kind in STORE_KINDS if key in item]
+    if len(kinds) != 1:
+      raise ConfigError(f"{where} must define exactly one of "
+                        "`lubeTier`, `gravityTier`, `oxyTier` or `endGame`.")
+    key, kind = kinds[0]
+    argument = 0 if key == "endGame" else expect_s16(item, key, where)
+    prestige = 0
+    if "prestige" in item:
+      prestige = expect_s32(item, "prestige", where)
+    store += struct.pack("<hhhhi",
+      kind,
+      argument,
+      expect_s16(item, "price", where),
+      expect_s16(item, "icon", where),
+      prestige)
+    store += strings.add(expect_string(item, "name", where))
+    store += strings.add(expect_string(item, "desc", where))
+
+  if len(root["store"]) > 0xFFFF:
+    raise ConfigError("`store` has too many elements.")
+
+  body = bytes(fixed) + bytes(store) + bytes(strings.data)
+  total = 16 + len(body)
+  header = CONFIG_MAGIC + struct.pack("<HHII",
+    CONFIG_VERSION, len(root["store"]), len(strings.data), total)
+  return header + body
+
+# Texture atlas. The game looks sprites up in atlas.json, see `AssetLoader`
+# in source/sbs/assets.cpp. The original files stay in the bundle so states
+# started before the table is resident (and older builds) still find them.
+
+ATLAS_SPRITES = ["bars.png", "brick.png", "icons.png", "socials.png",
+                 "shitter.png", "toilet.png", "toiletF.png", "water.png"]
+ATLAS_MAX_SIZE = 2048
+# edge pixels are repeated this far out, so filtering never samples a
+# neighbouring sprite
+ATLAS_PADDING = 2
+
+PNG_MAGIC = b"\x89PNG\r\n\x1a\n"
+
+class AtlasError(Exception):
+  pass
+
+class Image:
+  def __init__(self, width: int, height: int, pixels: bytearray):
+    self.width = width
+    self.height = height
+    self.pixels = pixels # RGBA8, row-major
+
+def paeth(a: int, b: int, c: int) -> int:
+  p = a + b - c
+  pa = abs(p - a)
+  pb = abs(p - b)
+  pc = abs(p - c)
+  if pa <= pb and pa <= pc:
+    return a
+  if pb <= pc:
+    return b
+  return c
+
+def unfilter(raw: bytes, width: int, height: int, bpp: int) -> bytearray:
+  stride = width * bpp
+  out = bytearray(stride * height)
+  prev = bytearray(stride)
+  pos = 0
+  for y in range(height):
+    kind = raw[pos]
+    line = bytearray(raw[pos + 1:pos + 1 + stride])
+    pos += 1 + stride
+    if kind == 1:
+      for x in range(bpp, stride):
+        line[x] = (line[x] + line[x - bpp]) & 0xFF
+    elif kind == 2:
+      for x in range(stride):
+        line[x] = (line[x] + prev[x]) & 0xFF
+    elif kind == 3:
+      for x in range(stride):
+        left = line[x - bpp] if x >= bpp else 0
+        line[x] = (line[x] + ((left + prev[x]) >> 1)) & 0xFF
+    elif kind == 4:
+      for x in range(stride):
+        left = line[x - bpp] if x >= bpp else 0
+        upleft = prev[x - bpp] if x >= bpp else 0
+        line[x] = (line[x] + paeth(left, prev[x], upleft)) & 0xFF
+    elif kind != 0:
+      raise AtlasError(f"unknown filter type {kind}")
+    out[y * stride:(y + 1) * stride] = line
+    prev = line
+  return out
+
+def read_png(path: bip.Path) -> Image:
+  data = path.read_bytes()
+  if data[:8] != PNG_MAGIC:
+    raise AtlasError("not a PNG")
+  pos = 8
+  header = None
+  palette = b""
+  alpha = b""
+  idat = bytearray()
+  while pos < len(data):
+    length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+    chunk = data[pos + 8:pos + 8 + length]
+    pos += 12 + length
+    if kind == b"IHDR":
+      header = struct.unpack(">IIBBBBB", chunk)
+    elif kind == b"PLTE":
+      palette = chunk
+    elif kind == b"tRNS":
+      alpha = chunk
+    elif kind == b"IDAT":
+      idat += chunk
+    elif kind == b"IEND":
+      break
+  if header is None:
+    raise AtlasError("no IHDR chunk")
+
+  width, height, depth, color, _, _, interlace = header
+  channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color)
+  if depth != 8 or interlace != 0 or channels is None:
+    raise AtlasError("only non-interlaced 8-bit images are supported")
+  raw = unfilter(zlib.decompress(bytes(idat)), width, height, channels)
+
+  if color == 6:
+    return Image(width, height, raw)
+  pixels = bytearray(width * height * 4)
+  for i in range(width * height):
+    if color == 2:
+      r, g, b = raw[3*i:3*i + 3]
+      a = 255
+    elif color == 3:
+      idx = raw[i]
+      r, g, b = palette[3*idx:3*idx + 3]
+      a = alpha[idx] if idx < len(alpha) else 255
+    elif color == 0:
+      r = g = b = raw[i]
+      a = 255
+    else:
+      r = g = b = raw[2*i]
+      a = raw[2*i + 1]
+    pixels[4*i:4*i + 4] = bytes((r, g, b, a))
+  return Image(width, height, pixels)
+
+def write_png(image: Image) -> bytes:
+  """Encodes as RGBA8, or as paletted 8-bit when the image has no more than
+  256 distinct colors."""
+  texels = memoryview(image.pixels).cast("I")
+  colors = set(texels)
+  if len(colors) <= 256:
+    palette = sorted(colors)
+    lut = {color: i for i, color in enumerate(palette)}
+    pixels = bytes(map(lut.__getitem__, texels))
+    stride = image.width
+  else:
+    palette = None
+    pixels = image.pixels
+    stride = image.width * 4
+  raw = bytearray()
+  for y in range(image.height):
+    raw.append(0)
+    raw += pixels[y * stride:(y + 1) * stride]
+
+  def chunk(kind: bytes, body: bytes) -> bytes:
+    crc = zlib.crc32(kind + body) & 0xFFFFFFFF
+    return struct.pack(">I", len(body)) + kind + body + struct.pack(">I", crc)
+
+  if palette is None:
+    header = struct.pack(">IIBBBBB", image.width, image.height, 8, 6, 0, 0, 0)
+    extra = b""
+  else:
+    header = struct.pack(">IIBBBBB", image.width, image.height, 8, 3, 0, 0, 0)
+    rgba = b"".join(struct.pack("<I", color) for color in palette)
+    extra = (chunk(b"PLTE", b"".join(rgba[i:i + 3] for i in range(0, len(rgba), 4)))
+      + chunk(b"tRNS", bytes(rgba[3::4])))
+  return (PNG_MAGIC
+    + chunk(b"IHDR", header)
+    + extra
+    + chunk(b"IDAT", zlib.compress(bytes(raw), 9))
+    + chunk(b"IEND", b""))
+
+def blit(page: Image, image: Image, left: int, top: int):
+  """Copies `image` into `page` with its top-left pixel at (left, top),
+  repeating the edges `ATLAS_PADDING` pixels outwards."""
+  pad = ATLAS_PADDING
+  for y in range(-pad, image.height + pad):
+    srcy = min(max(y, 0), image.height - 1)
+    src = srcy * image.width * 4
+    row = image.pixels[src:src + image.width * 4]
+    left_edge = row[:4] * pad
+    right_edge = row[-4:] * pad
+    dst = ((top + y) * page.width + left - pad) * 4
+    line = left_edge + row + right_edge
+    page.pixels[dst:dst + len(line)] = line
+
+def shelf_pack(sizes: list[tuple[int, int]]) -> tuple[list, int, int]:
+  """Places rects tallest first on shelves within `ATLAS_MAX_SIZE`."""
+  order = sorted(range(len(sizes)), key=lambda i: -sizes[i][1])
+  spots = [None] * len(sizes)
+  shelf_y = 0
+  shelf_h = 0
+  x = 0
+  used_w = 0
+  for idx in order:
+    w = sizes[idx][0] + 2*ATLAS_PADDING
+    h = sizes[idx][1] + 2*ATLAS_PADDING
+    if w > ATLAS_MAX_SIZE:
+      raise AtlasError(f"sprite is wider than {ATLAS_MAX_SIZE} pixels")
+    if x + w > ATLAS_MAX_SIZE:
+      shelf_y += shelf_h
+      shelf_h = 0
+      x = 0
+    spots[idx] = (x + ATLAS_PADDING, shelf_y + ATLAS_PADDING)
+    x += w
+    used_w = max(used_w, x)
+    shelf_h = max(shelf_h, h)
+  height = shelf_y + shelf_h
+  if height > ATLAS_MAX_SIZE:
+    raise AtlasError(f"sprites do not fit in {ATLAS_MAX_SIZE}x{ATLAS_MAX_SIZE}")
+  return spots, used_w, height
+
+def pack_atlas(src: bip.Path, stage: bip.Path) -> bool:
+  names = [name for name in ATLAS_SPRITES if (src / name).exists()]
+  images = []
+  for name in names:
+    try:
+      images.append(read_png(src / name))
+    except AtlasError as e:
+      bip.err(f"Could not read `{src / name}` for the atlas: {e}",
+               "Save it as a non-interlaced 8-bit PNG.")
+      return False
+
+  # sprites with identical pixels are packed once & share a region
+  slots = {}
+  slot_of = [slots.setdefault((i.width, i.height, bytes(i.pixels)), len(slots))
+             for i in images]
+  unique = [images[slot_of.index(slot)] for slot in range(len(slots))]
+
+  table = {"pages": [], "regions": []}
+  if images:
+    try:
+      spots, width, height = shelf_pack([(i.width, i.height) for i in unique])
+    except AtlasError as e:
+      bip.err(f"Could not pack the atlas: {e}",
+               "Remove a sprite from `ATLAS_SPRITES`.")
+      return False
+    page = Image(width, height, bytearray(width * height * 4))
+    for image, (x, y) in zip(unique, spots):
+      blit(page, image, x, y)
+    (stage / "atlas0.png").write_bytes(write_png(page))
+    table["pages"].append("atlas0.png")
+    for name, image, slot in zip(names, images, slot_of):
+      x, y = spots[slot]
+      table["regions"].append({
+        "name": name,
+        "page": 0,
+        "uv": [x / width, y / height, image.width / width, image.height / height],
+      })
+
+  if not pack_animations(src, stage, table):
+    return False
+  (stage / "atlas.json").write_text(json.dumps(table), encoding="utf-8")
+  return True
+
+def image_size(path: bip.Path) -> tuple[int, int] | None:
+  """Reads the dimensions out of a PNG or baseline/progressive JPEG header,
+  without decoding anything."""
+  data = path.read_bytes()
+  if data[:8] == PNG_MAGIC and data[12:16] == b"IHDR":
+    return struct.unpack(">II", data[16:24])
+  if data[:2] != b"\xff\xd8":
+    return None
+  pos = 2
+  while pos + 9 <= len(data):
+    if data[pos] != 0xFF:
+      return None
+    marker = data[pos + 1]
+    length = struct.unpack(">H", data[pos + 2:pos + 4])[0]
+    # SOF markers, minus DHT, JPG & DAC which share the range
+    if 0xC0 <= marker <= 0xCF and marker not in (0xC4, 0xC8, 0xCC):
+      height, width = struct.unpack(">HH", data[pos + 5:pos + 9])
+      return width, height
+    pos += 2 + length
+  return None
+
+def record_texture_sizes(stage: bip.Path):
+  """Adds the size of every staged texture to the atlas table, so the game's
+  asset dump can tell what the engine-decoded ones take up in VRAM. Runs
+  after staging, as downscaling changes the sizes."""
+  path = stage / "atlas.json"
+  table = json.loads(path.read_text(encoding="utf-8"))
+  sizes = []
+  for texture in sorted(stage.iterdir()):
+    if texture.suffix.lower() not in (".png", ".jpg", ".jpeg"):
+      continue
+    size = image_size(texture)
+    if size is not None:
+      sizes.append({"name": texture.name, "size": list(size)})
+  if table.get("textures") != sizes:
+    table["textures"] = sizes
+    path.write_text(json.dumps(table), encoding="utf-8")
+
+# Animated GIFs. Every animation in the bundle is decoded here, composited,
+# and its distinct frames are laid out on sprite sheet pages, so the game
+# only has to step through a timing table, see `Animation` in
+# source/sbs/Animation.hpp. The GIFs stay in the bundle for the same reason
+# the atlas keeps its sprites.
+
+class GifError(Exception):
+  pass
+
+# browsers play frames with no (or a 10ms) delay at this many centiseconds
+GIF_MIN_DELAY = 2
+GIF_DEFAULT_DELAY = 10
+
+def lzw_decode(data: bytes, min_size: int, count: int) -> bytearray:
+  clear = 1 << min_size
+  end = clear + 1
+  size = min_size + 1
+  table = [bytes((i,)) for i in range(clear)] + [b"", b""]
+  out = bytearray()
+  prev = None
+  bits = 0
+  nbits = 0
+  pos = 0
+  while len(out) < count:
+    while nbits < size:
+      if pos >= len(data):
+        return out
+      bits |= data[pos] << nbits
+      pos += 1
+      nbits += 8
+    code = bits & ((1 << size) - 1)
+    bits >>= size
+    nbits -= size
+    if code == clear:
+      size = min_size + 1
+      del table[clear + 2:]
+      prev = None
+      continue
+    if code == end:
+      break
+    if prev is None:
+      entry = table[code]
+    elif code < len(table):
+      entry = table[code]
+      table.append(prev + entry[:1])
+    else:
+      entry = prev + prev[:1]
+      table.append(entry)
+    out += entry
+    prev = entry
+    if len(table) == (1 << size) and size < 12:
+      size += 1
+  return out
+
+def read_sub_blocks(data: bytes, pos: int) -> tuple[bytearray, int]:
+  body = bytearray()
+  while pos < len(data) and data[pos] != 0:
+    body += data[pos + 1:pos + 1 + data[pos]]
+    pos += 1 + data[pos]
+  return body, pos + 1
+
+def read_gif(path: bip.Path) -> tuple[int, int, list[tuple[bytes, int]]]:
+  """Returns the canvas size and every composited RGBA8 frame along with
+  its delay in centiseconds."""
+  data = path.read_bytes()
+  if data[:6] not in (b"GIF87a", b"GIF89a"):
+    raise GifError("not a GIF")
+  width, height, flags = struct.unpack("<HHB", data[6:11])
+  pos = 13
+  global_palette = b""
+  if flags & 0x80:
+    size = 3 << ((flags & 7) + 1)
+    global_palette = data[pos:pos + size]
+    pos += size
+
+  canvas = bytearray(width * height * 4)
+  frames = []
+  delay = 0
+  transparent = None
+  disposal = 0
+  while pos < len(data):
+    kind = data[pos]
+    pos += 1
+    if kind == 0x3B:
+      break
+    if kind == 0x21:
+      label = data[pos]
+      body, pos = read_sub_blocks(data, pos + 1)
+      if label == 0xF9 and len(body) >= 4:
+        packed, delay, index = struct.unpack("<BHB", body[:4])
+        disposal = (packed >> 2) & 7
+        transparent = index if packed & 1 else None
+      continue
+    if kind != 0x2C:
+      raise GifError(f"unknown block {kind:#x}")
+
+    left, top, w, h, iflags = struct.unpack("<HHHHB", data[pos:pos + 9])
+    pos += 9
+    palette = global_palette
+    if iflags & 0x80:
+      size = 3 << ((iflags & 7) + 1)
+      palette = data[pos:pos + size]
+      pos += size
+    min_size = data[pos]
+    lzw, pos = read_sub_blocks(data, pos + 1)
+    indices = lzw_decode(bytes(lzw), min_size, w * h)
+    colors = [palette[i:i + 3] + b"\xff" for i in range(0, len(palette), 3)]
+
+    rows = list(range(h))
+    if iflags & 0x40:
+      rows = (list(range(0, h, 8)) + list(range(4, h, 8))
+        + list(range(2, h, 4)) + list(range(1, h, 2)))
+    previous = bytes(canvas) if disposal == 3 else None
+    right = min(left + w, width)
+    for row, y in enumerate(rows):
+      if top + y >= height:
+        continue
+      line = indices[row * w:row * w + right - left]
+      base = ((top + y) * width + left) * 4
+      for x, index in enumerate(line):
+        if index != transparent and index < len(colors):
+          canvas[base + x * 4:base + x * 4 + 4] = colors[index]
+    frames.append((bytes(canvas), delay))
+
+    if disposal == 2:
+      for y in range(top, min(top + h, height)):
+        base = (y * width + left) * 4
+        canvas[base:base + (right - left) * 4] = bytes((right - left) * 4)
+    elif disposal == 3:
+      canvas[:] = previous
+    delay = 0
+    transparent = None
+    disposal = 0
+  if not frames:
+    raise GifError("no frames")
+  return width, height, frames
+
+def pack_animation(src: bip.Path, stage: bip.Path, table: dict) -> bool:
+  try:
+    width, height, frames = read_gif(src)
+  except (GifError, IndexError, struct.error) as e:
+    bip.err(f"Could not decode `{src}`: {e}",
+             "Re-export it with an image editor.")
     return False
 
+  cell_w = width + 2*ATLAS_PADDING
+  cell_h = height + 2*ATLAS_PADDING
+  columns = ATLAS_MAX_SIZE // cell_w
+  rows = ATLAS_MAX_SIZE // cell_h
+  if columns == 0 or rows == 0:
+    # leave it to the engine
+    return True
+
+  # identical frames share a cell, consecutive ones are merged outright
+  cells = {}
+  timeline = []
+  for pixels, delay in frames:
+    if delay < GIF_MIN_DELAY:
+      delay = GIF_DEFAULT_DELAY
+    cell = cells.setdefault(pixels, len(cells))
+    if timeline and timeline[-1][0] == cell:
+      timeline[-1][1] += delay
+    else:
+      timeline.append([cell, delay])
+
+  per_page = columns * rows
+  stem = src.name.rsplit(".", 1)[0]
+  first_page = len(table["pages"])
+  page_sizes = []
+  distinct = list(cells)
+  for start in range(0, len(distinct), per_page):
+    chunk = distinct[start:start + per_page]
+    page_w = min(len(chunk), columns) * cell_w
+    page_h = ((len(chunk) + columns - 1) // columns) * cell_h
+    page = Image(page_w, page_h, bytearray(page_w * page_h * 4))
+    for i, pixels in enumerate(chunk):
+      x = (i % columns) * cell_w + ATLAS_PADDING
+      y = (i // columns) * cell_h + ATLAS_PADDING
+      blit(page, Image(width, height, bytearray(pixels)), x, y)
+    name = f"{stem}.sheet{start // per_page}.png"
+    (stage / name).write_bytes(write_png(page))
+    table["pages"].append(name)
+    page_sizes.append((page_w, page_h))
+
+  entries = []
+  for cell, delay in timeline:
+    page_w, page_h = page_sizes[cell // per_page]
+    slot = cell % per_page
+    x = (slot % columns) * cell_w + ATLAS_PADDING
+    y = (slot // columns) * cell_h + ATLAS_PADDING
+    entries.append({
+      "page": first_page + cell // per_page,
+      "uv": [x / page_w, y / page_h, width / page_w, height / page_h],
+      "time": delay / 100,
+    })
+  table["animations"].append({"name": src.name, "frames": entries})
+  return True
+
+def pack_animations(src: bip.Path, stage: bip.Path, table: dict) -> bool:
+  table["animations"] = []
+  for srcfile in sorted(src.iterdir()):
+    if srcfile.suffix.lower() != ".gif" or srcfile.name.startswith("_"):
+      continue
+    if not pack_animation(srcfile, stage, table):
+      return False
+  return True
+
+# Texture downscaling. nwge uploads every texture as RGBA8, so on low-end
+# GPUs the only lever the bundle has on VRAM is the resolution. Enabled with
+# `max-texture-size` in the [data] section of recipe.toml.
+
+def downscale(image: Image, factor: int) -> Image:
+  """Box filter by an integer factor. Colors are weighted by alpha so
+  transparent pixels do not darken the edges."""
+  width = (image.width + factor - 1) // factor
+  height = (image.height + factor - 1) // factor
+  out = bytearray(width * height * 4)
+  src = image.pixels
+  for y in range(height):
+    for x in range(width):
+      r = g = b = a = count = 0
+      for sy in range(y * factor, min((y + 1) * factor, image.height)):
+        row = sy * image.width
+        for sx in range(x * factor, min((x + 1) * factor, image.width)):
+          i = (row + sx) * 4
+          pa = src[i + 3]
+          r += src[i] * pa
+          g += src[i + 1] * pa
+          b += src[i + 2] * pa
+          a += pa
+          count += 1
+      i = (y * width + x) * 4
+      if a > 0:
+        out[i:i + 4] = bytes((r // a, g // a, b // a, a // count))
+  return Image(width, height, out)
+
+def stage_texture(src: bip.Path, dst: bip.Path, max_size: int) -> bool:
+  # sprites end up in the atlas at full size, anything the plugin can't
+  # decode is shipped as-is
+  if src.name in ATLAS_SPRITES:
+    shutil.copy2(src, dst)
+    return True
+  try:
+    image = read_png(src)
+  except AtlasError:
+    shutil.copy2(src, dst)
+    return True
+
+  largest = max(image.width, image.height)
+  if largest <= max_size:
+    shutil.copy2(src, dst)
+    return True
+  # UVs are normalized, so the game doesn't notice the smaller size
+  factor = (largest + max_size - 1) // max_size
+  dst.write_bytes(write_png(downscale(image, factor)))
   return True
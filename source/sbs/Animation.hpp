@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+Animation.hpp
+-------------
+Animated GIFs played back from sprite sheets
+*/
+
+#include "assets.hpp"
+#include <algorithm>
+#include <cmath>
+#include <nwge/common/def.h>
+#include <nwge/render/draw.hpp>
+#include <nwge/render/Texture.hpp>
+#include <vector>
+
+namespace sbs {
+
+/*
+An animation whose frames were decoded & laid out on sprite sheet pages by
+the bundle plugin, see `pack_animation` in source/bndl/plug.py. Playing it
+only steps through the timing table, it never decodes anything.
+
+When the bundle's atlas table was not resident yet (or has no sheets for
+the animation) the GIF is loaded as a `render::AnimatedTexture` instead and
+the calls below are passed on to it.
+
+Starts playing as soon as it is loaded, like `render::AnimatedTexture`.
+*/
+class Animation {
+public:
+  [[nodiscard]]
+  inline bool packed() const {
+    return !mFrames.empty();
+  }
+
+  /* Rewinds to the first frame & holds it. */
+  inline void stop() {
+    mTime = 0.0f;
+    mPlaying = false;
+    if(!packed() && mFallback.present()) {
+      mFallback->stop();
+    }
+  }
+
+  inline void play() {
+    mPlaying = true;
+    if(!packed() && mFallback.present()) {
+      mFallback->play();
+    }
+  }
+
+  inline void tick(f32 delta) {
+    if(!mPlaying || !packed()) {
+      return;
+    }
+    mTime = std::fmod(mTime + delta, mFrames.back().end);
+  }
+
+  /* Seconds until the next frame takes over, 0 when not stepping through
+     the timing table. */
+  [[nodiscard]]
+  inline f32 untilNextFrame() const {
+    if(!mPlaying || !packed()) {
+      return 0.0f;
+    }
+    return frame().end - mTime;
+  }
+
+  inline void draw(glm::vec3 pos, glm::vec2 size) const {
+    if(!packed()) {
+      if(mFallback.present()) {
+        nwge::render::rect(pos, size, *mFallback);
+      }
+      return;
+    }
+    const auto &sprite = frame().sprite;
+    nwge::render::rect(pos, size, *sprite.texture, {sprite.uvPos, sprite.uvSize});
+  }
+
+private:
+  friend class AssetLoader;
+
+  struct Frame {
+    Sprite sprite;
+    /* time at which the next frame takes over */
+    f32 end;
+  };
+
+  std::vector<Frame> mFrames;
+  Asset<nwge::render::AnimatedTexture> mFallback;
+  f32 mTime = 0.0f;
+  bool mPlaying = true;
+
+  [[nodiscard]]
+  inline const Frame &frame() const {
+    auto iter = std::upper_bound(mFrames.begin(), mFrames.end(), mTime,
+      [](f32 time, const Frame &frame){ return time < frame.end; });
+    if(iter == mFrames.end()) {
+      return mFrames.back();
+    }
+    return *iter;
+  }
+};
+
+} // namespace sbs
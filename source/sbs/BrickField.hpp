@@ -0,0 +1,245 @@
+#pragma once
+
+/*
+BrickField.hpp
+--------------
+The falling brick screensaver shared by the menu, the extras & the void
+*/
+
+#include "Rng.hpp"
+#include <array>
+#include <cmath>
+#include <nwge/common/array.hpp>
+#include <nwge/common/def.h>
+#include <nwge/render/AspectRatio.hpp>
+#include <nwge/render/draw.hpp>
+#include <nwge/render/mat.hpp>
+#include <nwge/render/Texture.hpp>
+#include <SDL2/SDL_stdinc.h>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace sbs {
+
+class BrickField {
+public:
+  /* how the aspect ratio correction is applied to each brick */
+  enum DeStretch {
+    DeStretchNone, // bricks are drawn in raw screen space
+    DeStretchPos,  // brick positions are corrected
+    DeStretchSize, // brick sizes are corrected
+  };
+
+  struct Params {
+    s32 count = 100;
+    f32 speed = 0.1f;
+    f32 width = 0.04f;
+    f32 height = 0.08f;
+    f32 baseZ = 0.53f;
+    DeStretch deStretch = DeStretchNone;
+  };
+
+  /* upper bound for `Params::count`, no matter who asks */
+  static constexpr s32 cMaxCount = 1 << 17;
+
+  BrickField(const Params &params)
+    : mParams(params)
+  {
+    resize(params.count);
+  }
+
+  [[nodiscard]]
+  inline s32 count() const {
+    return s32(mY.size());
+  }
+
+  /* Reallocates the brick buffers & scatters the bricks all over the screen. */
+  inline void resize(s32 count) {
+    mParams.count = SDL_clamp(count, 0, cMaxCount);
+    auto size = usize(mParams.count);
+    mX = {size};
+    mY = {size};
+    mZ = {size};
+    mRotation = {size};
+    mRotationSpeed = {size};
+    populate();
+  }
+
+  inline void populate() {
+    respawn(mY.size(), [](usize i){ return u32(i); }, true);
+  }
+
+  /* Restarts the random sequence from `seed` & scatters the bricks again,
+     for runs which have to be repeatable. */
+  inline void reseed(u32 seed) {
+    mRng.reseed(seed);
+    populate();
+  }
+
+  /* Integrates every brick, collecting the ones which fell off the bottom,
+     then respawns those in one batch. */
+  inline void update(f32 delta) {
+    const f32 fall = mParams.speed * delta;
+    const usize count = mY.size();
+    mDead.clear();
+    usize i = 0;
+#if defined(__AVX__)
+    const __m256 fallV = _mm256_set1_ps(fall);
+    const __m256 deltaV = _mm256_set1_ps(delta);
+    const __m256 deathV = _mm256_set1_ps(cDeathY);
+    for(; i + 8 <= count; i += 8) {
+      __m256 y = _mm256_add_ps(_mm256_loadu_ps(&mY[i]),
+        _mm256_mul_ps(fallV, _mm256_loadu_ps(&mZ[i])));
+      _mm256_storeu_ps(&mY[i], y);
+      _mm256_storeu_ps(&mRotation[i], _mm256_add_ps(_mm256_loadu_ps(&mRotation[i]),
+        _mm256_mul_ps(_mm256_loadu_ps(&mRotationSpeed[i]), deltaV)));
+      collectDead(i, u32(_mm256_movemask_ps(_mm256_cmp_ps(y, deathV, _CMP_GE_OQ))));
+    }
+#elif defined(__SSE2__)
+    const __m128 fallV = _mm_set1_ps(fall);
+    const __m128 deltaV = _mm_set1_ps(delta);
+    const __m128 deathV = _mm_set1_ps(cDeathY);
+    for(; i + 4 <= count; i += 4) {
+      __m128 y = _mm_add_ps(_mm_loadu_ps(&mY[i]),
+        _mm_mul_ps(fallV, _mm_loadu_ps(&mZ[i])));
+      _mm_storeu_ps(&mY[i], y);
+      _mm_storeu_ps(&mRotation[i], _mm_add_ps(_mm_loadu_ps(&mRotation[i]),
+        _mm_mul_ps(_mm_loadu_ps(&mRotationSpeed[i]), deltaV)));
+      collectDead(i, u32(_mm_movemask_ps(_mm_cmpge_ps(y, deathV))));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t fallV = vdupq_n_f32(fall);
+    const float32x4_t deltaV = vdupq_n_f32(delta);
+    const float32x4_t deathV = vdupq_n_f32(cDeathY);
+    for(; i + 4 <= count; i += 4) {
+      float32x4_t y = vaddq_f32(vld1q_f32(&mY[i]),
+        vmulq_f32(fallV, vld1q_f32(&mZ[i])));
+      vst1q_f32(&mY[i], y);
+      vst1q_f32(&mRotation[i], vaddq_f32(vld1q_f32(&mRotation[i]),
+        vmulq_f32(vld1q_f32(&mRotationSpeed[i]), deltaV)));
+      uint32x4_t dead = vcgeq_f32(y, deathV);
+      if(vmaxvq_u32(dead) != 0) {
+        collectDead(i, (vgetq_lane_u32(dead, 0) & 1) | (vgetq_lane_u32(dead, 1) & 2)
+          | (vgetq_lane_u32(dead, 2) & 4) | (vgetq_lane_u32(dead, 3) & 8));
+      }
+    }
+#endif
+    for(; i < count; ++i) {
+      mY[i] += fall * mZ[i];
+      mRotation[i] += mRotationSpeed[i] * delta;
+      if(mY[i] >= cDeathY) {
+        mDead.push_back(u32(i));
+      }
+    }
+    respawn(mDead.size(), [this](usize i){ return mDead[i]; }, false);
+  }
+
+  /* `uvPos` & `uvSize` select the region of `texture` holding the brick. */
+  inline void render(
+    const nwge::render::Texture &texture,
+    const nwge::render::AspectRatio &deStretch,
+    glm::vec2 uvPos = {0, 0}, glm::vec2 uvSize = {1, 1}
+  ) const {
+    const bool scaleSize = mParams.deStretch == DeStretchSize;
+    glm::vec2 sizeScale{1, 1};
+    if(scaleSize) {
+      sizeScale = deStretch.size({1, 1});
+    }
+
+    const glm::vec2 halfSize{mParams.width/2.0f, mParams.height/2.0f};
+    for(usize i = 0; i < mY.size(); ++i) {
+      f32 depth = mZ[i];
+      f32 depth2 = depth * depth;
+      glm::vec2 pos{mX[i], mY[i]};
+      if(mParams.deStretch == DeStretchPos) {
+        pos = deStretch.pos(pos);
+      }
+      nwge::render::color({depth, depth, depth});
+      nwge::render::mat::push();
+      nwge::render::mat::translate({
+        pos.x + halfSize.x,
+        pos.y + halfSize.y,
+        mParams.baseZ - depth * cZIncrement});
+      if(scaleSize) {
+        nwge::render::mat::scale({sizeScale, 1});
+      }
+      nwge::render::mat::rotate(mRotation[i], {0, 0, 1});
+      nwge::render::mat::scale({
+        mParams.width * depth2,
+        mParams.height * depth2,
+        1});
+      // the pivot sits half an unscaled brick away from the corner, which in
+      // the scaled space is half a unit divided by the depth scale
+      nwge::render::rect(
+        {-0.5f / depth2, -0.5f / depth2, 0},
+        {1, 1},
+        texture,
+        {uvPos, uvSize});
+      nwge::render::mat::pop();
+    }
+  }
+
+private:
+  static constexpr f32
+    cMinDistance = 0.1f,
+    cMaxDistance = 1.0f,
+    cMinX = -0.05f,
+    cMaxX = 1.05f,
+    cMinY = -0.3f,
+    cMaxStartY = -0.1f,
+    cDeathY = 1.1f,
+    cZIncrement = 0.001f,
+    cMinRotSpeed = -0.2f,
+    cMaxRotSpeed = 0.2f;
+
+  /* bricks respawned per batch of uniforms */
+  static constexpr usize cBatch = 64;
+  /* uniforms drawn per brick: x, y, distance, rotation & rotation speed */
+  static constexpr usize cUniforms = 5;
+
+  Params mParams;
+  // one array per component, so `update` streams through them in SIMD
+  // registers
+  nwge::Array<f32> mX, mY, mZ, mRotation, mRotationSpeed;
+
+  BatchRng mRng{Rng::randomSeed()};
+  std::array<f32, cBatch * cUniforms> mUniforms{};
+  /* bricks to respawn, kept around so frames don't allocate */
+  std::vector<u32> mDead;
+
+  inline void collectDead(usize first, u32 mask) {
+    while(mask != 0) {
+      mDead.push_back(u32(first + usize(__builtin_ctz(mask))));
+      mask &= mask - 1;
+    }
+  }
+
+  /* Scatters the `count` bricks `index(0..count)` returns. */
+  template<typename IndexFn>
+  inline void respawn(usize count, IndexFn index, bool onScreen) {
+    const f32 minY = cMinY;
+    const f32 maxY = onScreen ? cDeathY : cMaxStartY;
+    for(usize start = 0; start < count; start += cBatch) {
+      usize batch = SDL_min(cBatch, count - start);
+      mRng.fillUnit(mUniforms.data(), batch * cUniforms);
+      for(usize k = 0; k < batch; ++k) {
+        const f32 *unit = &mUniforms[k * cUniforms];
+        u32 i = index(start + k);
+        mX[i] = cMinX + unit[0] * (cMaxX - cMinX);
+        mY[i] = minY + unit[1] * (maxY - minY);
+        mZ[i] = cMinDistance + unit[2] * (cMaxDistance - cMinDistance);
+        mRotation[i] = f32(-M_PI) + unit[3] * f32(2 * M_PI);
+        mRotationSpeed[i] = cMinRotSpeed + unit[4] * (cMaxRotSpeed - cMinRotSpeed);
+      }
+    }
+  }
+};
+
+} // namespace sbs
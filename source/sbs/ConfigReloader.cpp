@@ -0,0 +1,82 @@
+#include "ConfigReloader.hpp"
+#include "perf.hpp"
+#include <bit>
+#include <nwge/console.hpp>
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+void ConfigReloader::tick(f32 delta, Config &config) {
+  if(mWatching) {
+    mPollTimer += delta;
+    if(mPollTimer >= cPollInterval) {
+      mPollTimer = 0.0f;
+      std::error_code error;
+      auto lastWrite = std::filesystem::last_write_time(mPath, error);
+      // editors replace files as they save, so a missing file is skipped
+      // until it shows up again
+      if(!error && lastWrite != mLastWrite) {
+        mLastWrite = lastWrite;
+        mRequested = true;
+      }
+    }
+  }
+  if(mRequested) {
+    mRequested = false;
+    reload(config);
+  }
+}
+
+void ConfigReloader::watch() {
+  std::error_code error;
+  mLastWrite = std::filesystem::last_write_time(mPath, error);
+  mWatching = true;
+  mPollTimer = 0.0f;
+  console::print("watching {}", StringView{mPath.data(), mPath.size()});
+}
+
+void ConfigReloader::unwatch() {
+  mWatching = false;
+  console::print("no longer watching {}", StringView{mPath.data(), mPath.size()});
+}
+
+void ConfigReloader::reload(Config &config) {
+  SBS_PERF_SCOPE("config reload");
+  StringView path{mPath.data(), mPath.size()};
+  auto *file = SDL_RWFromFile(mPath.c_str(), "rb");
+  if(file == nullptr) {
+    console::error("Could not open {}: {}", path, SDL_GetError());
+    return;
+  }
+  s64 size = SDL_RWsize(file);
+  std::string data(usize(SDL_max(size, 0)), '\0');
+  bool ok = size > 0 && SDL_RWread(file, data.data(), 1, data.size()) == data.size();
+  SDL_RWclose(file);
+  if(!ok) {
+    console::error("Could not read {}: {}", path, SDL_GetError());
+    return;
+  }
+
+  Config fresh;
+  // quietly: a half-saved file must not stop the game with a dialog
+  if(!fresh.loadMemory({data.data(), data.size()}, Config::ConsoleErrors)) {
+    console::error("Keeping the current config, {} did not load.", path);
+    return;
+  }
+  u32 changed = config.diff(fresh);
+  if(changed == 0) {
+    console::note("Reloaded {}, nothing changed.", path);
+    return;
+  }
+  // the string views move along with the storage they point into
+  fresh.storeRevision = config.storeRevision + ((changed & Config::StoreSection) != 0);
+  config = std::move(fresh);
+  console::note("Reloaded {}, {} sections changed.", path, std::popcount(changed));
+  mOnChange(changed);
+}
+
+} // namespace sbs
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+ConfigReloader.hpp
+------------------
+Live reloading of the config from a loose file, for tuning
+*/
+
+#include "config.hpp"
+#include <filesystem>
+#include <functional>
+#include <nwge/console/Command.hpp>
+#include <string>
+#include <utility>
+
+namespace sbs {
+
+/*
+Owns the `sbs.reloadConfig [path]` & `sbs.watchConfig [path|off]` commands.
+The commands only take note, the state owning the config applies the
+reload from its `tick`, so nothing ever changes in the middle of a frame.
+
+The file may be plain JSON or compiled by the bundle plugin. It is parsed
+into a fresh `Config`, diffed against the live one section by section and
+moved over it whole; a file which does not parse leaves the live config
+alone, with the reason on the console rather than in a dialog. The whole
+file is parsed every time, only the derived state is invalidated per
+section.
+*/
+class ConfigReloader {
+public:
+  /* where `source/data/cfg.json` is when running from the checkout */
+  static constexpr const char *cDefaultPath = "source/data/cfg.json";
+  /* how often a watched file is checked for changes */
+  static constexpr f32 cPollInterval = 0.5f;
+
+  /* Called with the `Config::Section`s which changed, once applied. */
+  using Callback = std::function<void(u32 changed)>;
+
+  explicit ConfigReloader(Callback &&onChange)
+    : mOnChange(std::move(onChange))
+  {}
+
+  void tick(f32 delta, Config &config);
+
+private:
+  Callback mOnChange;
+  std::string mPath = cDefaultPath;
+  bool mRequested = false;
+  bool mWatching = false;
+  f32 mPollTimer = 0.0f;
+  std::filesystem::file_time_type mLastWrite{};
+
+  nwge::console::Command mReloadCommand{"sbs.reloadConfig", [this](auto &args){
+    if(args.size() >= 1) {
+      mPath.assign(args[0].begin(), args[0].size());
+    }
+    mRequested = true;
+  }};
+
+  nwge::console::Command mWatchCommand{"sbs.watchConfig", [this](auto &args){
+    if(args.size() == 0) {
+      watch();
+      return;
+    }
+    std::string arg{args[0].begin(), args[0].size()};
+    if(arg == "off") {
+      unwatch();
+      return;
+    }
+    mPath = std::move(arg);
+    watch();
+  }};
+
+  void watch();
+  void unwatch();
+  void reload(Config &config);
+};
+
+} // namespace sbs
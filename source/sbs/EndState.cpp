@@ -1,7 +1,11 @@
+#include "Animation.hpp"
+#include "assets.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "save.hpp"
 #include "states.hpp"
 #include <nwge/data/bundle.hpp>
-#include <nwge/data/store.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/draw.hpp>
 
@@ -11,44 +15,63 @@ namespace sbs {
 
 class EndState: public State {
 private:
-  data::Bundle mBundle;
-  render::AnimatedTexture mTexture;
+  Recorder::Listener mListener{"EndState"};
+  AssetLoader mAssets;
+  Animation mTexture;
   f32 mCountdown = 11.91f;
   audio::Source mSource;
-  audio::Buffer mSound;
+  Asset<audio::Buffer> mSound;
 
-  data::Store mStore;
   Savefile mSave{};
 
 public:
   bool preload() override {
-    mBundle
-      .load({"sbs.bndl"})
-      .nqCustom("michael.gif", mTexture)
+    SBS_PERF_SCOPE("EndState::preload");
+    // --menu, --game & --end start here instead of the warning screen
+    SBS_PERF_MILESTONE("first preload");
+    mAssets
+      .nqAnimation("michael.gif", mTexture)
       .nqCustom("michael.wav", mSound);
-    mStore.nqLoad("save.json", mSave.v2);
+    saveScheduler().nqLoad(mSave);
     return true;
   }
 
   bool init() override {
-    auto prestige = s16(mSave.v2.prestige + 1);
+    SBS_PERF_SCOPE("EndState::init");
+    if(!mAssets.finish()) {
+      return false;
+    }
+    saveScheduler().resolve(mSave);
+    auto prestige = s16(mSave.v3.prestige + 1);
     mSave = {};
-    mSave.v2.prestige = prestige;
-    mStore.nqSave("save.json", mSave);
-    mSource.buffer(mSound);
+    mSave.v3.prestige = prestige;
+    mSave.dirty = true;
+    saveScheduler().flush(mSave);
+    mSource.buffer(*mSound);
     mSource.play();
     // nwge starts playing the animation immediately, so we have to stop it
     // first to reset back to the first frame and then start it again to ensure
     // it's in sync with audio
     mTexture.stop();
     mTexture.play();
+    framePacer().enter(FramePacer::Menu);
     return true;
   }
 
   bool tick(f32 delta) override {
+    SBS_PERF_SCOPE("EndState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
+    mTexture.tick(delta);
+    // only redrawn when the GIF moves on to its next frame
+    if(mTexture.packed()) {
+      framePacer().wakeIn(mTexture.untilNextFrame());
+    } else {
+      framePacer().dirty();
+    }
     mCountdown -= delta;
     if(mCountdown <= 0) {
-      if(mSave.v2.prestige == 1) {
+      if(mSave.v3.prestige == 1) {
         dialog::info("Notification", "Something new has appeared in the store...");
       }
       return false;
@@ -57,7 +80,8 @@ public:
   }
 
   void render() const override {
-    render::rect({0, 0, 0}, {1, 1}, mTexture);
+    SBS_PERF_SCOPE("EndState::render");
+    mTexture.draw({0, 0, 0}, {1, 1});
   }
 };
 
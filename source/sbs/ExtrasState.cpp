@@ -1,11 +1,17 @@
+#include "assets.hpp"
+#include "BrickField.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
+#include "TextRun.hpp"
 #include <nwge/bind.hpp>
 #include <nwge/data/bundle.hpp>
+#include <nwge/render/AspectRatio.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/Texture.hpp>
 #include <nwge/render/mat.hpp>
 #include <nwge/render/window.hpp>
-#include <random>
 
 using namespace nwge;
 
@@ -18,26 +24,45 @@ public:
   {}
 
   bool preload() override {
-    mBundle
-      .load({"sbs.bndl"})
+    SBS_PERF_SCOPE("ExtrasState::preload");
+    mAssets
       .nqFont("GrapeSoda.cfn"_sv, mFont)
       .nqTexture("email.png"_sv, mEMail)
       .nqTexture("deving.png"_sv, mDevingTexture)
       .nqTexture("rock.png"_sv, mRockTexture)
-      .nqTexture("brick.png"_sv, mBrickTexture)
-      .nqCustom("credits.txt"_sv, mCredits);
+      .nqTexture("brick.png"_sv, mBrickTexture);
+    mAssets.bundle().nqCustom("credits.txt"_sv, mCredits);
     return true;
   }
 
+  static void prefetch(AssetLoader &assets) {
+    assets
+      .prefetchFont("GrapeSoda.cfn"_sv)
+      .prefetchTexture("email.png"_sv)
+      .prefetchTexture("deving.png"_sv)
+      .prefetchTexture("rock.png"_sv)
+      .prefetchTexture("brick.png"_sv);
+  }
+
   bool init() override {
-    populateBricks();
+    SBS_PERF_SCOPE("ExtrasState::init");
+    if(!mAssets.finish()) {
+      return false;
+    }
+    mBricks.reseed(u32(recorder().seed()));
+    mCreditsText.set(*mFont, mCredits, cButtonTextH);
+    framePacer().enter(FramePacer::Menu);
     return true;
   }
 
   bool on(Event &evt) override {
+    if(!recorder().event(evt)) {
+      return true;
+    }
     if(mFadeOut >= 0 || mFadeIn >= 0) {
       return true;
     }
+    framePacer().dirty();
 
     Button hover;
     switch(evt.type) {
@@ -64,9 +89,15 @@ public:
   }
 
   bool tick(f32 delta) override {
-    updateBricks(delta);
+    SBS_PERF_SCOPE("ExtrasState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
+    // the bricks behind the tabs are background, they are left to step at
+    // the idle rate
+    mBricks.update(delta);
 
     if(mFadeIn >= 0) {
+      framePacer().dirty();
       mFadeIn += delta;
       if(mFadeIn >= 1.0f) {
         mFadeIn = -1;
@@ -75,6 +106,7 @@ public:
     }
 
     if(mFadeOut >= 0) {
+      framePacer().dirty();
       mFadeOut += delta;
       if(mFadeOut >= 1.0f) {
         swapStatePtr(getMenuState(std::move(mMusic)));
@@ -85,8 +117,9 @@ public:
   }
 
   void render() const override {
+    SBS_PERF_SCOPE("ExtrasState::render");
     render::clear({0, 0, 0});
-    renderBricks(mBrickTexture);
+    mBricks.render(*mBrickTexture.texture, m1x1, mBrickTexture.uvPos, mBrickTexture.uvSize);
 
     render::color(cBgClr);
     render::rect({cInnerX, cInnerY, cBgZ}, {cInnerW, cInnerH});
@@ -95,7 +128,7 @@ public:
       {cSeparatorX, cSeparatorY, cTextZ},
       {cSeparatorW, cSeparatorH});
 
-    mFont.draw("Extras", {cBigTextX, cBigTextY, cTextZ}, cBigTextH);
+    mFont->draw("Extras", {cBigTextX, cBigTextY, cTextZ}, cBigTextH);
     renderButton("Lore", BLore);
     renderButton("BTS", BBehindTheScenes);
     renderButton("Credits", BCredits);
@@ -135,14 +168,32 @@ public:
   }
 
 private:
+  enum Bind: u8 {
+    BindNext,
+    BindPrev,
+  };
+
+  Recorder::Listener mListener{"ExtrasState",
+    [this](Event &evt){ on(evt); },
+    [this](u8 bind){
+      if(bind == BindNext) {
+        next();
+      } else {
+        prev();
+      }
+    }};
   Music mMusic;
-  data::Bundle mBundle;
-  render::Font mFont;
+  AssetLoader mAssets;
+  Asset<render::Font> mFont;
   KeyBind mNext{"sbs.next", Key::Right, [this]{
-    next();
+    if(recorder().bind(BindNext)) {
+      next();
+    }
   }};
   KeyBind mPrev{"sbs.prev", Key::Left, [this]{
-    prev();
+    if(recorder().bind(BindPrev)) {
+      prev();
+    }
   }};
 
   void next() {
@@ -245,10 +296,10 @@ private:
     } else {
       render::color(cButtonTextClr);
     }
-    mFont.draw(name, {baseX + cButtonTextX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
+    mFont->draw(name, {baseX + cButtonTextX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
   }
 
-  render::Texture mEMail;
+  Asset<render::Texture> mEMail;
 
   static constexpr f32
     cLoreMailX = cInnerX + cInnerPad,
@@ -260,10 +311,10 @@ private:
     render::rect(
       {cLoreMailX, cLoreMailY, cTextZ},
       {cLoreMailW, cLoreMailH},
-      mEMail);
+      *mEMail);
   }
 
-  render::Texture mDevingTexture;
+  Asset<render::Texture> mDevingTexture;
 
   static constexpr f32
     cDevingX = cInnerX + cInnerPad,
@@ -284,9 +335,9 @@ private:
     render::rect(
       {cDevingX, cDevingY, cTextZ},
       {cDevingW, cDevingH},
-      mDevingTexture,
+      *mDevingTexture,
       {{texX, 0}, {cDevingTexW, 1}});
-    mFont.draw(
+    mFont->draw(
       "Use arrows to cycle screenshots",
       {cDevingTextX, cDevingTextY, cTextZ},
       cButtonTextH);
@@ -295,14 +346,14 @@ private:
   static constexpr f32 cCreditsTextX = cInnerX + 0.05f;
 
   String<> mCredits;
+  TextRun mCreditsText;
 
   void renderCreditsTab() const {
-    glm::vec2 measure = mFont.measure(mCredits, cButtonTextH);
-    f32 textY = cInnerY + (cInnerH - measure.y)/2.0f;
-    mFont.draw(mCredits, {cCreditsTextX, textY, cTextZ}, cButtonTextH);
+    f32 textY = cInnerY + (cInnerH - mCreditsText.size().y)/2.0f;
+    mCreditsText.draw({cCreditsTextX, textY, cTextZ});
   }
 
-  render::Texture mRockTexture;
+  Asset<render::Texture> mRockTexture;
 
   static constexpr f32
     cRockX = cInnerX + cInnerPad,
@@ -311,114 +362,27 @@ private:
     cRockH = cRockW;
 
   void renderRockTab() const {
-    render::rect({cRockX, cRockY, cTextZ}, {cRockW, cRockH}, mRockTexture);
+    render::rect({cRockX, cRockY, cTextZ}, {cRockW, cRockH}, *mRockTexture);
   }
 
-  static constexpr s32 cBrickCount = 50;
-
-  static constexpr f32
-    cBrickSpeed = 0.1f,
-    cBrickW = 0.04f,
-    cBrickH = 0.08f,
-    cBrickMinDistance = 0.1f,
-    cBrickMaxDistance = 1.0f,
-    cBrickMinX = -0.05f,
-    cBrickMaxX = 1.05f,
-    cBrickMinY = -0.3f,
-    cBrickMaxStartY = -0.1f,
-    cBrickDeathY = 1.1f,
-    cBrickBaseZ = 0.7f,
-    cBrickZIncrement = 0.001f,
-    cBrickMinRotSpeed = -0.2f,
-    cBrickMaxRotSpeed = 0.2f;
-
-  static constexpr glm::vec3
-    cBrickColor{0.667f, 0.29f, 0.267f};
-
-  render::Texture mBrickTexture;
-
-  struct Brick {
-    glm::vec3 pos;
-    f32 rotation;
-    f32 rotationSpeed;
-
-    void regenerate(bool onScreen) {
-      static std::mt19937 sEng{std::random_device{}()};
-      static std::uniform_real_distribution<f32>
-        sDistanceDis{cBrickMinDistance, cBrickMaxDistance};
-      static std::uniform_real_distribution<f32>
-        sRotDis{-M_PI, M_PI};
-      static std::uniform_real_distribution<f32>
-        sXDis{cBrickMinX, cBrickMaxX};
-      static std::uniform_real_distribution<f32>
-        sYDis{cBrickMinY, cBrickMaxStartY};
-      static std::uniform_real_distribution<f32>
-        sOnScreenYDis{cBrickMinY, cBrickDeathY};
-      static std::uniform_real_distribution<f32>
-        sRotSpeedDis{cBrickMinRotSpeed, cBrickMaxRotSpeed};
-
-      pos.x = sXDis(sEng);
-      if(onScreen) {
-        pos.y = sOnScreenYDis(sEng);
-      } else {
-        pos.y = sYDis(sEng);
-      }
-      pos.z = sDistanceDis(sEng);
-      rotation = sRotDis(sEng);
-      rotationSpeed = sRotSpeedDis(sEng);
-    }
-
-    void update(f32 delta) {
-      pos.y += cBrickSpeed * delta * pos.z;
-
-      if(pos.y >= cBrickDeathY) {
-        regenerate(false);
-        return;
-      }
-
-      rotation += rotationSpeed * delta;
-    }
-
-    void render(const render::Texture &texture) const {
-      render::color({pos.z, pos.z, pos.z});
-      render::mat::push();
-      render::mat::translate({
-        pos.x, pos.y,
-        cBrickBaseZ - pos.z * cBrickZIncrement});
-      render::mat::translate({cBrickW/2.0f, cBrickH/2.0f, 0.0f});
-      render::mat::rotate(rotation, {0, 0, 1});
-      render::mat::translate({-cBrickW/2.0f, -cBrickH/2.0f, 0.0f});
-      render::mat::scale({
-        cBrickW * pos.z * pos.z,
-        cBrickH * pos.z * pos.z,
-        1});
-      render::rect({0, 0, 0}, {1, 1}, texture);
-      render::mat::pop();
-    }
-  };
-  std::array<Brick, cBrickCount> mBricks{};
-
-  void populateBricks() {
-    for(auto &brick: mBricks) {
-      brick.regenerate(true);
-    }
-  }
-
-  void updateBricks(f32 delta) {
-    for(auto &brick: mBricks) {
-      brick.update(delta);
-    }
-  }
+  BrickField mBricks{{
+    .count = 50,
+    .speed = 0.1f,
+    .width = 0.04f,
+    .height = 0.08f,
+    .baseZ = 0.7f,
+  }};
 
-  void renderBricks(const render::Texture &texture) const {
-    for(const auto &brick: mBricks) {
-      brick.render(texture);
-    }
-  }
+  Sprite mBrickTexture;
+  render::AspectRatio m1x1{1, 1};
 };
 
 State *getExtrasState(Music &&music) {
   return new ExtrasState(std::move(music));
 }
 
+void prefetchExtrasState(AssetLoader &assets) {
+  ExtrasState::prefetch(assets);
+}
+
 } // namespace sbs
@@ -0,0 +1,109 @@
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include <nwge/console.hpp>
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_stdinc.h>
+#include <SDL2/SDL_timer.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+FramePacer::Mode FramePacer::enter(Mode mode) {
+  Mode previous = mMode;
+  mMode = mode;
+  // whatever was on screen before is gone
+  mDirty = true;
+  return previous;
+}
+
+void FramePacer::wakeIn(f32 seconds) {
+  seconds = SDL_max(seconds, 0.0f);
+  if(mWake < 0.0f || seconds < mWake) {
+    mWake = seconds;
+  }
+}
+
+void FramePacer::pace() {
+  if(!mFirstFrame && mLastFrame != 0) {
+    // nwge renders & swaps after every tick, so by the second tick the
+    // first frame is on screen
+    mFirstFrame = true;
+    SBS_PERF_MILESTONE("first frame");
+  }
+  auto freq = f64(SDL_GetPerformanceFrequency());
+  u64 now = SDL_GetPerformanceCounter();
+  if(mDirty) {
+    mDirty = false;
+    mLastDirty = now;
+  }
+  bool idle = mMode == Menu
+    && f64(now - mLastDirty) / freq >= cIdleGrace
+    && mWake != 0.0f;
+
+  f32 fps = mLimits.gameFps;
+  if(mMode == Menu) {
+    fps = idle ? mLimits.idleFps : mLimits.menuFps;
+  }
+  f64 budget = fps > 0.0f ? 1.0 / f64(fps) : 0.0;
+  if(idle && mWake > 0.0f) {
+    budget = SDL_min(budget, f64(mWake));
+  }
+  mWake = -1.0f;
+
+  f64 left = budget - f64(now - mLastFrame) / freq;
+  if(left >= 0.001) {
+    auto millis = u32(left * 1000.0);
+    if(!idle) {
+      SDL_Delay(millis);
+    } else if(SDL_WaitEventTimeout(nullptr, s32(millis)) != 0) {
+      // the event is left queued for nwge to hand out next frame
+      ++mStats.wokenByInput;
+      mLastDirty = SDL_GetPerformanceCounter();
+    }
+  }
+
+  u64 after = SDL_GetPerformanceCounter();
+  mStats.waited += f64(after - now) / freq;
+  mLastFrame = after;
+  ++mStats.frames;
+  if(idle) {
+    ++mStats.idleFrames;
+  }
+}
+
+void FramePacer::set(const StringView &which, f32 fps) {
+  fps = SDL_max(fps, 0.0f);
+  if(which == "game"_sv) {
+    mLimits.gameFps = fps;
+  } else if(which == "menu"_sv) {
+    mLimits.menuFps = fps;
+  } else if(which == "idle"_sv) {
+    mLimits.idleFps = fps;
+  } else {
+    console::error("expected game, menu or idle, got {}", which);
+    return;
+  }
+  console::print("{} cap set to {} fps", which, fps);
+}
+
+void FramePacer::report() {
+  console::print("caps: game {} fps, menu {} fps, idle {} fps (0 = vsync)",
+    mLimits.gameFps, mLimits.menuFps, mLimits.idleFps);
+  console::print("mode: {}", mMode == Menu ? "menu" : "gameplay");
+  if(mStats.frames != 0) {
+    console::print("  {} frames, {} idle, {} idle frames woken by input, "
+      "{} ms waited per frame",
+      mStats.frames, mStats.idleFrames, mStats.wokenByInput,
+      mStats.waited * 1000.0 / f64(mStats.frames));
+  }
+  mStats = {};
+}
+
+FramePacer &framePacer() {
+  // leaked for the same reason as the asset cache
+  static auto *sPacer = new FramePacer;
+  return *sPacer;
+}
+
+} // namespace sbs
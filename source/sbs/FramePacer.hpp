@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+FramePacer.hpp
+--------------
+Frame rate caps, and idling on screens which are not changing
+*/
+
+#include <cstdlib>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/console/Command.hpp>
+#include <string>
+
+namespace sbs {
+
+/*
+Paces the main loop from inside the top-level state's `tick`, the only place
+the game gets to run between frames.
+
+Gameplay runs at `gameFps`. Menus run at `menuFps` while something on them
+changes, but a state has to say so: input, animations & timers mark the
+screen dirty, or schedule a wake-up for when they will change it. Once a
+menu has been clean for a moment it idles at `idleFps`, and an idle frame
+is cut short by the first event coming in, so input never waits for it.
+
+nwge draws & presents every frame it runs, so an idle frame still presents
+the same picture again; it just happens a lot less often.
+*/
+class FramePacer {
+public:
+  enum Mode {
+    Gameplay,
+    Menu,
+  };
+
+  /* Frames per second, 0 leaves the rate to vsync. */
+  struct Limits {
+    f32 gameFps = 0.0f;
+    f32 menuFps = 60.0f;
+    f32 idleFps = 20.0f;
+  };
+
+  /* how long a menu stays at full rate after its last change, so hovers &
+     such settle before it starts idling */
+  static constexpr f32 cIdleGrace = 0.1f;
+
+  void configure(const Limits &limits) {
+    mLimits = limits;
+  }
+
+  /* Switches to another cap. Returns the previous mode, for substates to
+     restore once they are popped. */
+  Mode enter(Mode mode);
+
+  /* The screen changed, or will next frame. */
+  void dirty() {
+    mDirty = true;
+  }
+
+  /* The screen will change in `seconds` by itself, idling waits no longer. */
+  void wakeIn(f32 seconds);
+
+  /* Called first thing in the tick of every top-level state, and of
+     substates pushed without ticking their parent; never from other
+     substates, whose parent already calls it. Waits out whatever is left of
+     the current frame's budget. */
+  void pace();
+
+private:
+  Limits mLimits;
+  Mode mMode = Gameplay;
+  bool mDirty = true;
+  /* seconds until a scheduled change, negative if none */
+  f32 mWake = -1.0f;
+  u64 mLastDirty = 0;
+  u64 mLastFrame = 0;
+  bool mFirstFrame = false;
+
+  struct Stats {
+    u32 frames = 0;
+    u32 idleFrames = 0;
+    u32 wokenByInput = 0;
+    f64 waited = 0.0;
+  };
+  Stats mStats;
+
+  /* `sbs.fps` reports, `sbs.fps game|menu|idle <fps>` changes a cap */
+  nwge::console::Command mCommand{"sbs.fps", [this](auto &args){
+    if(args.size() >= 2) {
+      std::string value{args[1].begin(), args[1].size()};
+      set(args[0], std::strtof(value.c_str(), nullptr));
+      return;
+    }
+    report();
+  }};
+
+  void set(const nwge::StringView &which, f32 fps);
+  void report();
+};
+
+FramePacer &framePacer();
+
+} // namespace sbs
@@ -1,3 +1,7 @@
+#include "assets.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
 #include <nwge/data/bundle.hpp>
 #include <nwge/render/AspectRatio.hpp>
@@ -11,7 +15,7 @@ namespace sbs {
 
 class IntroState: public State {
 private:
-  render::Texture mLogo;
+  Asset<render::Texture> mLogo;
 
   f32 mFadeIn = 0.0f;
   f32 mLinger = 0.0f;
@@ -29,29 +33,55 @@ private:
   static constexpr glm::vec3 cLogoPos{cLogoOff, cLogoOff, cLogoZ};
   static constexpr glm::vec2 cLogoSize{cLogoSide, cLogoSide};
 
+  Recorder::Listener mListener{"IntroState"};
   Music mMusic;
+  AssetLoader mAssets;
 
 public:
-  IntroState(render::Texture &&logoTexture, Music &&music)
-    : mLogo(std::move(logoTexture)), mMusic(std::move(music))
+  IntroState(Music &&music)
+    : mMusic(std::move(music))
   {}
 
+  bool preload() override {
+    SBS_PERF_SCOPE("IntroState::preload");
+    // loaded here rather than with the warning screen: by far the biggest
+    // entry in the bundle, and the first screen doesn't need it
+    mMusic.nq(mAssets.bundle());
+    // so is the logo, which the warning screen only used to carry over
+    mAssets.nqTexture("logo1.png", mLogo);
+    // the logo is all this state shows, so the menu's load rides along with
+    // the music instead of adding another gap once the logo fades out
+    prefetchMenuState(mAssets);
+    return true;
+  }
+
   bool init() override {
+    SBS_PERF_SCOPE("IntroState::init");
+    if(!mAssets.finish()) {
+      return false;
+    }
     mMusic.play();
+    framePacer().enter(FramePacer::Menu);
     return true;
   }
 
   bool tick(f32 delta) override {
+    SBS_PERF_SCOPE("IntroState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
     if(mFadeIn < cFadeInDur) {
       mFadeIn += delta;
+      framePacer().dirty();
       return true;
     }
     if(mLinger < cLingerDur) {
       mLinger += delta;
+      framePacer().wakeIn(cLingerDur - mLinger);
       return true;
     }
     if(mFadeOut < cFadeOutDur) {
       mFadeOut += delta;
+      framePacer().dirty();
       return true;
     }
     swapStatePtr(getMenuState(std::move(mMusic)));
@@ -59,6 +89,7 @@ public:
   }
 
   void render() const override {
+    SBS_PERF_SCOPE("IntroState::render");
     render::clear({0, 0, 0});
     if(mFadeIn < cFadeInDur) {
       render::color({1, 1, 1, mFadeIn/cFadeInDur});
@@ -67,12 +98,12 @@ public:
     } else if(mFadeOut < cFadeOutDur) {
       render::color({1, 1, 1, 1.0f - mFadeOut/cFadeOutDur});
     }
-    render::rect(m1x1.pos(cLogoPos), m1x1.size(cLogoSize), mLogo);
+    render::rect(m1x1.pos(cLogoPos), m1x1.size(cLogoSize), *mLogo);
   }
 };
 
-State *getIntroState(render::Texture &&logoTexture, Music &&music) {
-  return new IntroState(std::move(logoTexture), std::move(music));
+State *getIntroState(Music &&music) {
+  return new IntroState(std::move(music));
 }
 
 } // namespace sbs
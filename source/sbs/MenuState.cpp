@@ -1,11 +1,19 @@
+#include "Animation.hpp"
+#include "assets.hpp"
+#include "BrickField.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "save.hpp"
 #include "version.h"
 #include "states.hpp"
 #include "minigames.hpp"
+#include "TextRun.hpp"
+#include "ui.hpp"
+#include <algorithm>
 #include <array>
 #include <nwge/console/Command.hpp>
 #include <nwge/data/bundle.hpp>
-#include <nwge/data/store.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/AspectRatio.hpp>
 #include <nwge/render/draw.hpp>
@@ -21,8 +29,9 @@ namespace sbs {
 
 class MenuState: public State {
 private:
-  data::Bundle mBundle{"sbs"_sv};
-  render::AnimatedTexture mLogo;
+  Recorder::Listener mListener{"MenuState", [this](Event &evt){ on(evt); }};
+  AssetLoader mAssets;
+  Animation mLogo;
 
   f32 mFadeIn = 0.0f;
   f32 mFadeOut = -1.0f;
@@ -43,109 +52,18 @@ private:
   static constexpr glm::vec3 cLogoPos{cLogoX, cLogoY, cLogoZ};
   static constexpr glm::vec2 cLogoSize{cLogoW, cLogoH};
 
-  static constexpr s32 cBrickCount = 100;
-
-  static constexpr f32
-    cBrickSpeed = 0.1f,
-    cBrickW = 0.04f,
-    cBrickH = 0.08f,
-    cBrickMinDistance = 0.1f,
-    cBrickMaxDistance = 1.0f,
-    cBrickMinX = -0.05f,
-    cBrickMaxX = 1.05f,
-    cBrickMinY = -0.3f,
-    cBrickMaxStartY = -0.1f,
-    cBrickDeathY = 1.1f,
-    cBrickBaseZ = 0.53f,
-    cBrickZIncrement = 0.001f,
-    cBrickMinRotSpeed = -0.2f,
-    cBrickMaxRotSpeed = 0.2f;
-
-  static constexpr glm::vec3
-    cBrickColor{0.667f, 0.29f, 0.267f};
-
-  render::Texture mBrickTexture;
-
-  struct Brick {
-    glm::vec3 pos;
-    f32 rotation;
-    f32 rotationSpeed;
-
-    void regenerate(bool onScreen) {
-      static std::mt19937 sEng{std::random_device{}()};
-      static std::uniform_real_distribution<f32>
-        sDistanceDis{cBrickMinDistance, cBrickMaxDistance};
-      static std::uniform_real_distribution<f32>
-        sRotDis{-M_PI, M_PI};
-      static std::uniform_real_distribution<f32>
-        sXDis{cBrickMinX, cBrickMaxX};
-      static std::uniform_real_distribution<f32>
-        sYDis{cBrickMinY, cBrickMaxStartY};
-      static std::uniform_real_distribution<f32>
-        sOnScreenYDis{cBrickMinY, cBrickDeathY};
-      static std::uniform_real_distribution<f32>
-        sRotSpeedDis{cBrickMinRotSpeed, cBrickMaxRotSpeed};
-
-      pos.x = sXDis(sEng);
-      if(onScreen) {
-        pos.y = sOnScreenYDis(sEng);
-      } else {
-        pos.y = sYDis(sEng);
-      }
-      pos.z = sDistanceDis(sEng);
-      rotation = sRotDis(sEng);
-      rotationSpeed = sRotSpeedDis(sEng);
-    }
-
-    void update(f32 delta) {
-      pos.y += cBrickSpeed * delta * pos.z;
-
-      if(pos.y >= cBrickDeathY) {
-        regenerate(false);
-        return;
-      }
-
-      rotation += rotationSpeed * delta;
-    }
-
-    void render(const render::Texture &texture, const render::AspectRatio &deStretch) const {
-      render::color({pos.z, pos.z, pos.z});
-      render::mat::push();
-      render::mat::translate({
-        deStretch.pos({pos.x, pos.y}),
-        cBrickBaseZ - pos.z * cBrickZIncrement});
-      render::mat::translate({cBrickW/2.0f, cBrickH/2.0f, 0.0f});
-      render::mat::rotate(rotation, {0, 0, 1});
-      render::mat::translate({-cBrickW/2.0f, -cBrickH/2.0f, 0.0f});
-      render::mat::scale({
-        cBrickW * pos.z * pos.z,
-        cBrickH * pos.z * pos.z,
-        1});
-      render::rect({0, 0, 0}, {1, 1}, texture);
-      render::mat::pop();
-    }
-  };
-  std::array<Brick, cBrickCount> mBricks{};
-
-  void populateBricks() {
-    for(auto &brick: mBricks) {
-      brick.regenerate(true);
-    }
-  }
-
-  void updateBricks(f32 delta) {
-    for(auto &brick: mBricks) {
-      brick.update(delta);
-    }
-  }
+  BrickField mBricks{{
+    .count = 100,
+    .speed = 0.1f,
+    .width = 0.04f,
+    .height = 0.08f,
+    .baseZ = 0.53f,
+    .deStretch = BrickField::DeStretchPos,
+  }};
 
-  void renderBricks(const render::Texture &texture, const render::AspectRatio &deStretch) const {
-    for(const auto &brick: mBricks) {
-      brick.render(texture, deStretch);
-    }
-  }
+  Sprite mBrickTexture;
 
-  render::Font mFont;
+  Asset<render::Font> mFont;
 
   static constexpr f32
     cTextZ = 0.4f,
@@ -167,61 +85,119 @@ private:
     cHoverTextColor{1, 1, 1, 1};
 
   struct ReviewManager {
-    Array<String<>> reviews;
-
-    bool load(data::RW &file) {
-      ScratchArray<char> data{usize(file.size())};
-      if(!file.read(data.view())) {
-        dialog::error("Error", "Could not load reviews: I/O error");
-        return false;
+    struct Reviews {
+      /* Views into `text`, which holds every quote & name back to back, so a
+         file of thousands of reviews costs two allocations rather than one
+         per review. They are only formatted once one is put on screen. */
+      struct Entry {
+        StringView quote;
+        StringView person;
+        f64 rating;
+      };
+      Array<Entry> entries;
+      Array<char> text;
+
+      Array<char> raw;
+      decltype(json::OK) jsonError = json::OK;
+      const char *error = nullptr;
+      s64 errorReview = -1;
+
+      bool read(data::RW &file) {
+        raw = {usize(file.size())};
+        if(!file.read(raw.view())) {
+          dialog::error("Error", "Could not load reviews: I/O error");
+          return false;
+        }
+        return true;
       }
-      auto res = json::parse(data.view());
-      if(res.error != json::OK) {
-        dialog::error("Error", "Could not load reviews: Invalid JSON ({})",
-          json::errorMessage(res.error));
-        return false;
+
+      void decode() {
+        auto res = json::parse(raw.view());
+        if(res.error != json::OK) {
+          jsonError = res.error;
+          return;
+        }
+        if(!res.value->isArray()) {
+          error = "Not an array";
+          return;
+        }
+
+        auto array = res.value->array();
+        usize textSize = 0;
+        for(usize i = 0; i < array.size(); ++i) {
+          const auto &value = array[i];
+          if(!value.isObject()) {
+            error = "Not an object";
+            errorReview = s64(i);
+            return;
+          }
+          const auto &object = value.object();
+          const auto *personV = object.get("person");
+          if(personV == nullptr || !personV->isString()) {
+            error = "Invalid `person`";
+            errorReview = s64(i);
+            return;
+          }
+          const auto *quoteV = object.get("quote");
+          if(quoteV == nullptr || !quoteV->isString()) {
+            error = "Invalid `quote`";
+            errorReview = s64(i);
+            return;
+          }
+          const auto *ratingV = object.get("rating");
+          if(ratingV == nullptr || !ratingV->isNumber()) {
+            error = "Invalid `rating`";
+            errorReview = s64(i);
+            return;
+          }
+          textSize += quoteV->string().size() + personV->string().size();
+        }
+
+        text = {textSize};
+        char *cursor = textSize == 0 ? nullptr : &text[0];
+        auto copy = [&cursor](StringView string){
+          char *start = cursor;
+          std::copy_n(string.begin(), string.size(), cursor);
+          cursor += string.size();
+          return StringView{start, string.size()};
+        };
+        entries = {array.size()};
+        for(usize i = 0; i < entries.size(); ++i) {
+          const auto &object = array[i].object();
+          entries[i].quote = copy(object.get("quote")->string());
+          entries[i].person = copy(object.get("person")->string());
+          entries[i].rating = object.get("rating")->number();
+        }
       }
-      if(!res.value->isArray()) {
-        dialog::error("Error", "Could not load reviews: Not an array");
-        return false;
+
+      [[nodiscard]]
+      ScratchString format(usize idx) const {
+        const auto &entry = entries[idx];
+        return ScratchString::formatted("\"{} {}/10\"\n   ~ {}",
+          entry.quote, entry.rating, entry.person);
       }
 
-      auto array = res.value->array();
-      reviews = {array.size()};
-      for(usize i = 0; i < reviews.size(); ++i) {
-        const auto &value = array[i];
-        if(!value.isObject()) {
-          dialog::error("Error", "Could not load review {}: Not an object",
-            i);
-          return false;
-        }
-        const auto &object = value.object();
-        const auto *personV = object.get("person");
-        if(personV == nullptr || !personV->isString()) {
-          dialog::error("Error", "Could not load review {}: Invalid `person`",
-            i);
+      bool finish() {
+        raw = {};
+        if(jsonError != json::OK) {
+          dialog::error("Error", "Could not load reviews: Invalid JSON ({})",
+            json::errorMessage(jsonError));
           return false;
         }
-        const auto *quoteV = object.get("quote");
-        if(quoteV == nullptr || !quoteV->isString()) {
-          dialog::error("Error", "Could not load review {}: Invalid `quote`",
-            i);
+        if(error != nullptr && errorReview >= 0) {
+          dialog::error("Error", "Could not load review {}: {}",
+            errorReview, error);
           return false;
         }
-        const auto *ratingV = object.get("rating");
-        if(ratingV == nullptr || !ratingV->isNumber()) {
-          dialog::error("Error", "Could not load review {}: Invalid `rating`",
-            i);
+        if(error != nullptr) {
+          dialog::error("Error", "Could not load reviews: {}", error);
           return false;
         }
-        reviews[i] = String<>::formatted("\"{} {}/10\"\n   ~ {}",
-          quoteV->string(), ratingV->number(), personV->string());
+        console::note("Loaded {} reviews.", entries.size());
+        return true;
       }
-
-      console::note("Loaded {} reviews.", reviews.size());
-      reviewIdxDis = std::uniform_int_distribution<usize>{0, reviews.size() - 1};
-      return true;
-    }
+    };
+    Asset<Reviews> reviews;
 
     static constexpr s32 cInstanceCount = 10;
     static constexpr f32
@@ -239,13 +215,13 @@ private:
     std::uniform_int_distribution<usize> reviewIdxDis;
 
     struct Instance {
-      StringView text;
+      TextRun text;
       glm::vec3 pos{};
       f32 fadeIn = 0.0f;
       ReviewManager *reviewManager = nullptr;
 
       void reset(ReviewManager *newReviewManager = nullptr) {
-        static std::mt19937 sEng{std::random_device{}()};
+        static std::mt19937 sEng{u32(recorder().seed())};
         static std::uniform_real_distribution<f32>
           sXDis{cReviewMinX, cReviewMaxX};
         static std::uniform_real_distribution<f32>
@@ -262,7 +238,7 @@ private:
         }
         if(reviewManager != nullptr) {
           auto idx = reviewManager->reviewIdxDis(sEng);
-          text = reviewManager->reviews[idx];
+          text.set(*reviewManager->font, reviewManager->reviews->format(idx), cReviewFontH);
         }
       }
 
@@ -276,14 +252,14 @@ private:
         }
       }
 
-      void render(f32 visualZ, const render::Font &font) const {
+      void render(f32 visualZ) const {
         f32 inverseZ = 1.0f - pos.z;
         f32 scale = 1.0f - (pos.z - cReviewMinZ) / (cReviewMaxZ - cReviewMinZ);
         f32 alpha = fadeIn > 0 ? 1.0f - fadeIn : 1;
         render::color({1, 1, 1, scale * alpha});
         f32 height = cReviewFontH * inverseZ;
-        auto measure = font.measure(text, height);
-        font.draw(text,
+        auto measure = text.size(height);
+        text.draw(
           {pos.x - measure.x / 2,
           pos.y - measure.y / 2,
           visualZ},
@@ -291,8 +267,11 @@ private:
       }
     };
     std::array<Instance, cInstanceCount> instances;
-    
-    void populateInstances() {
+    const render::Font *font = nullptr;
+
+    void populateInstances(const render::Font &newFont) {
+      font = &newFont;
+      reviewIdxDis = std::uniform_int_distribution<usize>{0, reviews->entries.size() - 1};
       for(auto &instance: instances) {
         instance.reset(this);
       }
@@ -304,16 +283,16 @@ private:
       }
     }
     
-    void renderInstances(const render::Font &font) const {
+    void renderInstances() const {
       for(s32 i = 0; i < cInstanceCount; ++i) {
         const auto &instance = instances[i];
         f32 visualZ = cReviewMinZ + f32(cInstanceCount - i) * cReviewIncZ;
-        instance.render(visualZ, font);
+        instance.render(visualZ);
       }
     }
   } mReviewManager;
 
-  render::Texture mVignetteTexture;
+  Asset<render::Texture> mVignetteTexture;
 
   Music mMusic;
 
@@ -359,7 +338,10 @@ private:
     cButtonTextClr{1, 1, 1, 1},
     cButtonSelectedTextClr{0, 0, 0, 1};
 
-  void renderButton(const StringView &name, Button button) const {
+  std::array<TextRun, BMax> mButtonText;
+  TextRun mCopyrightText, mVersionText;
+
+  void renderButton(Button button) const {
     f32 baseX = cButtonX;
     f32 baseY = cButtonY + f32(button) * cButtonH;
     if(mSelection == button) {
@@ -375,13 +357,12 @@ private:
     } else {
       render::color(cButtonTextClr);
     }
-    auto measure = mFont.measure(name, cButtonTextH);
-    f32 textX = (cButtonW - measure.x) / 2;
-    mFont.draw(name, {baseX + textX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
+    const auto &text = mButtonText[button];
+    f32 textX = (cButtonW - text.size().x) / 2;
+    text.draw({baseX + textX, baseY + cButtonTextY, cTextZ});
   }
 
-  Config mConfig;
-  data::Store mStore;
+  Asset<Config> mConfig;
   Savefile mSave;
 
   static constexpr s32 cSocialButtonCount = 2;
@@ -394,16 +375,17 @@ private:
     cSocialButtonTexUnit = 1.0f / cSocialButtonCount,
     cSocialButtonZ = cTextZ;
 
-  render::Texture mSocialsTexture;
+  Sprite mSocialsTexture;
 
   void renderSocialButton(s32 buttonNo) const {
     f32 buttonX = cSocialButtonX + f32(buttonNo) * cSocialButtonStride;
     f32 texX = f32(buttonNo) * cSocialButtonTexUnit;
-    render::rect(
+    drawSprite(
       {buttonX, cSocialButtonY, cSocialButtonZ},
       {cSocialButtonW, cSocialButtonH},
       mSocialsTexture,
-      {{texX, 0}, {cSocialButtonTexUnit, 1}});
+      {texX, 0},
+      {cSocialButtonTexUnit, 1});
   }
 
   void checkSocialButtonClick(glm::vec2 pos) const {
@@ -421,18 +403,23 @@ private:
     }
     switch(button) {
     case 0:
-      dialog::openURL(mConfig.socials.xDotCom);
+      dialog::openURL(mConfig->socials.xDotCom);
       break;
     case 1:
-      dialog::openURL(mConfig.socials.discord);
+      dialog::openURL(mConfig->socials.discord);
       break;
     default:
       break;
     }
   }
 
-  console::Command mTestMiniGameCommand{"sbs.testMiniGame", []{
-    swapStatePtr(getMiniGameState(MiniGame::test(), MiniGame::ReturnToMenu));
+  MiniGameAssets mMiniGameAssets;
+
+  console::Command mTestMiniGameCommand{"sbs.testMiniGame", [this]{
+    pushSubStatePtr(getMiniGameSubState(MiniGame::test(), mMiniGameAssets), {
+      .tickParent = false,
+      .renderParent = false,
+    });
   }};
 
 public:
@@ -441,30 +428,56 @@ public:
   {}
 
   bool preload() override {
-    mBundle
-      .nqCustom("sbs2024.gif"_sv, mLogo)
+    SBS_PERF_SCOPE("MenuState::preload");
+    // --menu, --game & --end start here instead of the warning screen
+    SBS_PERF_MILESTONE("first preload");
+    mAssets
+      .nqAnimation("sbs2024.gif"_sv, mLogo)
       .nqTexture("brick.png"_sv, mBrickTexture)
       .nqFont("GrapeSoda.cfn"_sv, mFont)
-      .nqCustom("reviews.json"_sv, mReviewManager)
+      .nqCustom("reviews.json"_sv, mReviewManager.reviews)
       .nqTexture("vignette.png"_sv, mVignetteTexture)
       .nqTexture("socials.png"_sv, mSocialsTexture)
       .nqCustom("cfg.json"_sv, mConfig);
-    mStore.nqLoad("progress"_sv, mSave.v1);
-    mStore.nqLoad("save.json"_sv, mSave.v2);
+    mMiniGameAssets.nq(mAssets);
+    // whichever button gets clicked, the next load gap is mostly gone
+    prefetchShitState(mAssets);
+    prefetchExtrasState(mAssets);
+    saveScheduler().nqLoad(mSave);
     return true;
   }
 
+  static void prefetch(AssetLoader &assets) {
+    assets
+      .prefetchAnimation("sbs2024.gif"_sv)
+      .prefetchTexture("brick.png"_sv)
+      .prefetchFont("GrapeSoda.cfn"_sv)
+      .prefetchCustom<ReviewManager::Reviews>("reviews.json"_sv)
+      .prefetchTexture("vignette.png"_sv)
+      .prefetchTexture("socials.png"_sv)
+      .prefetchCustom<Config>("cfg.json"_sv);
+  }
+
   bool init() override {
-    populateBricks();
-    mReviewManager.populateInstances();
-    mStore.nqSave("save.json", mSave);
-    if(mSave.v1.loaded) {
-      mStore.nqDelete("progress"_sv);
+    SBS_PERF_SCOPE("MenuState::init");
+    if(!mAssets.finish()) {
+      return false;
     }
+    mBricks.reseed(u32(recorder().seed()));
+    mReviewManager.populateInstances(*mFont);
+    mButtonText[BShit].set(*mFont, "Shit", cButtonTextH);
+    mButtonText[BExtras].set(*mFont, "Extras", cButtonTextH);
+    mCopyrightText.set(*mFont, "Copyright (c) Nwge Game Studio 2024", cCopyrightH);
+    mVersionText.set(*mFont, SBS_VER_STR, cVerH);
+    saveScheduler().resolve(mSave);
+    framePacer().enter(FramePacer::Menu);
     return true;
   }
 
   bool on(Event &evt) override {
+    if(!recorder().event(evt)) {
+      return true;
+    }
     if(mFadeOut >= 0.0f) {
       return true;
     }
@@ -482,7 +495,7 @@ public:
       }
       mHover = mSelection = hover;
       if(hover == BShit
-      ||(hover == BExtras && mSave.v2.prestige >= 1)) {
+      ||(hover == BExtras && mSave.v3.prestige >= 1)) {
         mFadeOut = 0.0f;
         break;
       }
@@ -494,7 +507,14 @@ public:
   }
 
   bool tick(f32 delta) override {
-    updateBricks(delta);
+    SBS_PERF_SCOPE("MenuState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
+    // the logo, bricks & reviews never stop moving, so the menu cap is all
+    // the pacing this screen gets
+    framePacer().dirty();
+    mLogo.tick(delta);
+    mBricks.update(delta);
     mReviewManager.updateInstances(delta);
 
     if(mFadeIn < cFadeInDur) {
@@ -525,31 +545,30 @@ public:
   }
 
   void render() const override {
+    SBS_PERF_SCOPE("MenuState::render");
     render::clear({0, 0, 0});
 
     render::color();
-    render::rect(m1x1.pos(cLogoPos), m1x1.size(cLogoSize), mLogo);
+    mLogo.draw(m1x1.pos(cLogoPos), m1x1.size(cLogoSize));
 
-    renderBricks(mBrickTexture, m1x1);
-    mReviewManager.renderInstances(mFont);
+    mBricks.render(*mBrickTexture.texture, m1x1, mBrickTexture.uvPos, mBrickTexture.uvSize);
+    mReviewManager.renderInstances();
 
-    renderButton("Shit", BShit);
-    if(mSave.v2.prestige >= 1) {
-      renderButton("Extras", BExtras);
+    renderButton(BShit);
+    if(mSave.v3.prestige >= 1) {
+      renderButton(BExtras);
     }
 
     render::color();
-    render::rect({0, 0, cVignetteZ}, {1, 1}, mVignetteTexture);
+    render::rect({0, 0, cVignetteZ}, {1, 1}, *mVignetteTexture);
 
     // render::color({1, 0, 0});
     // mFont.draw("If you leak this build we will leak your internal organs",
     //  {cCopyrightX, cCopyrightY - 2*cCopyrightH, cCopyrightZ}, cCopyrightH);
     render::color();
-    mFont.draw("Copyright (c) Nwge Game Studio 2024",
-      {cCopyrightX, cCopyrightY, cCopyrightZ}, cCopyrightH);
-    auto measure = mFont.measure(SBS_VER_STR, cVerH);
-    auto textX = cVerX - measure.x;
-    mFont.draw(SBS_VER_STR, {textX, cVerY, cVerZ}, cVerH);
+    mCopyrightText.draw({cCopyrightX, cCopyrightY, cCopyrightZ});
+    auto textX = cVerX - mVersionText.size().x;
+    mVersionText.draw({textX, cVerY, cVerZ});
 
     #pragma unroll
     for(s32 i = 0; i < cSocialButtonCount; ++i) {
@@ -570,4 +589,8 @@ State *getMenuState(Music &&music) {
   return new MenuState(std::move(music));
 }
 
+void prefetchMenuState(AssetLoader &assets) {
+  MenuState::prefetch(assets);
+}
+
 } // namespace sbs
@@ -0,0 +1,167 @@
+#include "assets.hpp"
+#include "FramePacer.hpp"
+#include "minigames.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
+#include "SpscRing.hpp"
+#include <memory>
+#include <nwge/bind.hpp>
+#include <nwge/console.hpp>
+#include <nwge/console/Command.hpp>
+#include <nwge/render/window.hpp>
+#include <nwge/render/draw.hpp>
+#include <nwge/render/Texture.hpp>
+#include <SDL2/SDL_timer.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+void MiniGameAssets::nq(AssetLoader &assets) {
+  assets
+    .nqFont("Symtext.cfn", font)
+    .nqTexture("scanlines.png", scanlines);
+}
+
+class MiniGameSubState: public SubState {
+public:
+  MiniGameSubState(MiniGame *miniGame, const MiniGameAssets &assets)
+    : mPreviousMode(framePacer().enter(FramePacer::Gameplay)),
+      mScanlineTexture(assets.scanlines), mMiniGame(miniGame)
+  {
+    SBS_PERF_SCOPE("MiniGameSubState::init");
+    mMiniGameData.font = assets.font;
+    mLeft.onRelease([this]{
+      bindInput(MiniGame::LeftReleased);
+    });
+    mRight.onRelease([this]{
+      bindInput(MiniGame::RightReleased);
+    });
+    mUp.onRelease([this]{
+      bindInput(MiniGame::UpReleased);
+    });
+    mDown.onRelease([this]{
+      bindInput(MiniGame::DownReleased);
+    });
+    mUse.onRelease([this]{
+      bindInput(MiniGame::UseReleased);
+    });
+    mMiniGame->init(mMiniGameData);
+    mLastTick = SDL_GetPerformanceCounter();
+  }
+
+  ~MiniGameSubState() override {
+    framePacer().enter(mPreviousMode);
+  }
+
+  bool tick(f32 delta) override {
+    SBS_PERF_SCOPE("MiniGameSubState::tick");
+    // pushed without ticking its parent, so nothing else paces & records
+    // the frame while it runs
+    framePacer().pace();
+    delta = recorder().frame(delta);
+    if(usize dropped = mInputs.takeDropped(); dropped != 0) {
+      console::error("Mini-game input ring full, dropped {} inputs.", dropped);
+    }
+
+    // inputs are placed on the mini-game clock by how far into the frame
+    // they came, so the times add up with the deltas
+    u64 now = SDL_GetPerformanceCounter();
+    f64 frame = f64(now - mLastTick);
+    TimedInput input;
+    while(mInputs.pop(input)) {
+      f64 fraction = 1.0;
+      if(frame > 0) {
+        fraction = SDL_clamp(f64(s64(input.counter - mLastTick)) / frame, 0.0, 1.0);
+      }
+      if(!mMiniGame->on(input.input, mClock + fraction * f64(delta))) {
+        returnFromMiniGame();
+        return true;
+      }
+    }
+    mLastTick = now;
+    mClock += f64(delta);
+    if(!mMiniGame->tick(delta)) {
+      returnFromMiniGame();
+      return true;
+    }
+    return true;
+  }
+
+  void render() const override {
+    SBS_PERF_SCOPE("MiniGameSubState::render");
+    render::clear({0, 0, 0});
+    render::color();
+    mMiniGame->render();
+    render::color();
+    render::rect({0, 0, cScanlineZ}, {1, 1}, *mScanlineTexture);
+  }
+
+private:
+  /* the key binds, numbered by their `MiniGame::Input` */
+  Recorder::Listener mListener{"MiniGameSubState", {}, [this](u8 bind){
+    addToInputBuffer(MiniGame::Input(bind));
+  }};
+  /* mini-games run at the gameplay cap, even over a menu */
+  FramePacer::Mode mPreviousMode;
+
+  /* scanlines.png is 1 pixel wide and has two rows per fake line: an opaque
+     black one followed by a transparent one, so the whole CRT overlay is a
+     single full-screen rect */
+  Asset<render::Texture> mScanlineTexture;
+  static constexpr f32 cScanlineZ = 0.01f;
+
+  MiniGame::Data mMiniGameData;
+  std::unique_ptr<MiniGame> mMiniGame;
+
+  struct TimedInput {
+    MiniGame::Input input;
+    u64 counter;
+  };
+  /* filled by the key binds, drained by `tick` */
+  SpscRing<TimedInput, 256> mInputs;
+  u64 mLastTick = 0;
+  f64 mClock = 0.0;
+
+  /* Replayed inputs are pushed while `frame` runs at the start of the tick,
+     so they land at the end of their frame rather than where they came. */
+  void addToInputBuffer(MiniGame::Input input) {
+    mInputs.push({input, SDL_GetPerformanceCounter()});
+  }
+
+  void bindInput(MiniGame::Input input) {
+    if(recorder().bind(u8(input))) {
+      addToInputBuffer(input);
+    }
+  }
+
+  KeyBind mLeft{"sbs.miniGame.left", Key::A, [this]{
+    bindInput(MiniGame::LeftPressed);
+  }};
+  KeyBind mRight{"sbs.miniGame.right", Key::D, [this]{
+    bindInput(MiniGame::RightPressed);
+  }};
+  KeyBind mUp{"sbs.miniGame.up", Key::W, [this]{
+    bindInput(MiniGame::UpPressed);
+  }};
+  KeyBind mDown{"sbs.miniGame.down", Key::S, [this]{
+    bindInput(MiniGame::DownPressed);
+  }};
+  KeyBind mUse{"sbs.miniGame.use", Key::E, [this]{
+    bindInput(MiniGame::UsePressed);
+  }};
+
+  void returnFromMiniGame() {
+    popSubState();
+  }
+
+  console::Command mReturnCommand{"sbs.return", [this]{
+    returnFromMiniGame();
+  }};
+};
+
+SubState *getMiniGameSubState(MiniGame *game, const MiniGameAssets &assets) {
+  return new MiniGameSubState(game, assets);
+}
+
+} // namespace sbs
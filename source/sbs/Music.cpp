@@ -1,25 +1,35 @@
 #include "Music.hpp"
+#include "perf.hpp"
 
 using namespace nwge;
 
 namespace sbs {
 
 void Music::nq(data::Bundle &bundle) {
+  if(loaded) {
+    return;
+  }
   buffer.label("music buffer");
   source.label("music source");
   bundle.nqCustom("GROOVY.WAV"_sv, *this);
 }
 
 bool Music::load(data::RW &file) {
+  audio::Sound sound;
   if(!sound.load(file)) {
     return false;
   }
   buffer.upload(sound);
   source.buffer(buffer);
+  loaded = true;
+  SBS_PERF_MILESTONE("music ready");
   return true;
 }
 
 void Music::play() {
+  if(!loaded) {
+    return;
+  }
   source.play();
 }
 
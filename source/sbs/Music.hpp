@@ -6,14 +6,20 @@
 
 namespace sbs {
 
+/*
+The menu music. Moved from state to state so it keeps playing across them.
+The decoded samples only live as long as it takes to upload them, after
+that the audio buffer is the only copy.
+*/
 struct Music {
-  nwge::audio::Sound sound;
   nwge::audio::Buffer buffer;
   nwge::audio::Source source;
+  bool loaded = false;
 
+  /* Enqueues the track, unless it has been loaded already. */
   void nq(nwge::data::Bundle &bundle);
   bool load(nwge::data::RW &file);
   void play();
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,332 @@
+#include "Recorder.hpp"
+#include "Rng.hpp"
+#include <algorithm>
+#include <cstring>
+#include <nwge/console.hpp>
+#include <nwge/dialog.hpp>
+#include <SDL2/SDL_error.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+namespace {
+
+constexpr usize cHeaderSize = 8;
+
+} // namespace
+
+Recorder::Listener::Listener(const char *name, EventFn &&onEvent, BindFn &&onBind)
+  : mOnEvent(std::move(onEvent)), mOnBind(std::move(onBind))
+{
+  auto &rec = recorder();
+  rec.mListeners.push_back(this);
+  rec.transition(name);
+}
+
+Recorder::Listener::~Listener() {
+  // states are swapped by creating the next one first, so this need not be
+  // the newest listener
+  auto &listeners = recorder().mListeners;
+  listeners.erase(std::remove(listeners.begin(), listeners.end(), this),
+    listeners.end());
+}
+
+bool Recorder::record(const char *path, Start start) {
+  mFile = SDL_RWFromFile(path, "wb");
+  if(mFile == nullptr) {
+    dialog::error("Error", "Could not create {}: {}", path, SDL_GetError());
+    return false;
+  }
+  put(cMagic);
+  put(cVersion);
+  put(u8(start));
+  put(u8(0)); // reserved
+  mMode = Recording;
+  flush();
+  return mMode == Recording;
+}
+
+bool Recorder::replay(const char *path, Start &start) {
+  auto *file = SDL_RWFromFile(path, "rb");
+  if(file == nullptr) {
+    dialog::error("Error", "Could not open {}: {}", path, SDL_GetError());
+    return false;
+  }
+  s64 size = SDL_RWsize(file);
+  mData.resize(usize(SDL_max(size, 0)));
+  bool ok = size >= s64(cHeaderSize)
+    && SDL_RWread(file, mData.data(), 1, mData.size()) == mData.size();
+  SDL_RWclose(file);
+  if(!ok) {
+    dialog::error("Error", "Could not read {}: {}", path, SDL_GetError());
+    return false;
+  }
+
+  u32 magic = 0;
+  u16 version = 0;
+  u8 startByte = 0;
+  u8 reserved = 0;
+  get(magic);
+  get(version);
+  get(startByte);
+  get(reserved);
+  if(magic != cMagic) {
+    dialog::error("Error", "{} is not a recording.", path);
+    return false;
+  }
+  if(version != cVersion) {
+    dialog::error("Error", "{} is a version {} recording, expected {}.",
+      path, version, cVersion);
+    return false;
+  }
+  if(startByte > StartEnd) {
+    dialog::error("Error", "{} starts in an unknown state.", path);
+    return false;
+  }
+  start = Start(startByte);
+  mMode = Replaying;
+  mReplayed = true;
+  return true;
+}
+
+void Recorder::finish() {
+  if(mMode == Recording) {
+    flush();
+  }
+  if(mFile != nullptr) {
+    SDL_RWclose(mFile);
+    mFile = nullptr;
+  }
+  mMode = Off;
+}
+
+bool Recorder::event(const Event &evt) {
+  if(mMode == Replaying) {
+    return mDispatching;
+  }
+  if(mMode != Recording) {
+    return true;
+  }
+  switch(evt.type) {
+  case Event::MouseDown:
+  case Event::MouseUp:
+    put(evt.type == Event::MouseDown ? TagMouseDown : TagMouseUp);
+    put(evt.click.pos.x);
+    put(evt.click.pos.y);
+    break;
+  case Event::MouseMotion:
+    put(TagMouseMotion);
+    put(evt.motion.to.x);
+    put(evt.motion.to.y);
+    break;
+  case Event::MouseScroll:
+    put(TagMouseScroll);
+    put(f32(evt.scroll));
+    break;
+  default:
+    // nothing in the game looks at the others
+    break;
+  }
+  return true;
+}
+
+bool Recorder::bind(u8 bind) {
+  if(mMode == Replaying) {
+    return mDispatching;
+  }
+  if(mMode == Recording) {
+    put(TagBind);
+    put(bind);
+  }
+  return true;
+}
+
+f32 Recorder::frame(f32 delta) {
+  mDelta = step(delta);
+  return mDelta;
+}
+
+f32 Recorder::step(f32 delta) {
+  if(mMode == Recording) {
+    put(TagFrame);
+    put(delta);
+    ++mFrames;
+    if(mData.size() >= cFlushSize) {
+      flush();
+    }
+    return delta;
+  }
+  if(mMode != Replaying) {
+    return delta;
+  }
+
+  for(;;) {
+    if(mPos == mData.size()) {
+      console::note("Replay finished after {} frames, see sbs.perf for the timings.",
+        mFrames);
+      mMode = Off;
+      return delta;
+    }
+    auto tag = Tag(mData[mPos++]);
+    if(tag == TagFrame) {
+      f32 recorded = 0.0f;
+      if(!get(recorded)) {
+        diverged("truncated frame");
+        return delta;
+      }
+      ++mFrames;
+      return recorded;
+    }
+    if(mListeners.empty()) {
+      diverged("input with no state to take it");
+      return delta;
+    }
+    auto &listener = *mListeners.back();
+
+    Event evt{};
+    bool ok = true;
+    switch(tag) {
+    case TagMouseDown:
+    case TagMouseUp:
+      evt.type = tag == TagMouseDown ? Event::MouseDown : Event::MouseUp;
+      ok = get(evt.click.pos.x) && get(evt.click.pos.y);
+      break;
+    case TagMouseMotion:
+      evt.type = Event::MouseMotion;
+      ok = get(evt.motion.to.x) && get(evt.motion.to.y);
+      break;
+    case TagMouseScroll: {
+      f32 scroll = 0.0f;
+      evt.type = Event::MouseScroll;
+      ok = get(scroll);
+      evt.scroll = decltype(evt.scroll)(scroll);
+      break;
+    }
+    case TagBind: {
+      u8 bind = 0;
+      if(!get(bind) || !listener.mOnBind) {
+        diverged("key bind the state does not have");
+        return delta;
+      }
+      mDispatching = true;
+      listener.mOnBind(bind);
+      mDispatching = false;
+      continue;
+    }
+    default:
+      diverged("unexpected record");
+      return delta;
+    }
+    if(!ok || !listener.mOnEvent) {
+      diverged(ok ? "input the state does not take" : "truncated event");
+      return delta;
+    }
+    mDispatching = true;
+    listener.mOnEvent(evt);
+    mDispatching = false;
+  }
+}
+
+u64 Recorder::seed() {
+  u64 seed = 0;
+  switch(mMode) {
+  case Recording:
+    seed = Rng::randomSeed();
+    put(TagSeed);
+    put(seed);
+    return seed;
+  case Replaying:
+    if(expect(TagSeed) && get(seed)) {
+      return seed;
+    }
+    diverged("expected a seed");
+    return Rng::randomSeed();
+  default:
+    return Rng::randomSeed();
+  }
+}
+
+void Recorder::save(SavefileV3 &save) {
+  if(mMode == Recording) {
+    put(TagSave);
+    put(save.score);
+    put(save.lubeTier);
+    put(save.gravityTier);
+    put(save.prestige);
+    put(save.oxyTier);
+    return;
+  }
+  if(mMode != Replaying) {
+    return;
+  }
+  SavefileV3 recorded;
+  if(expect(TagSave)
+  && get(recorded.score)
+  && get(recorded.lubeTier) && get(recorded.gravityTier)
+  && get(recorded.prestige) && get(recorded.oxyTier)) {
+    save.score = recorded.score;
+    save.lubeTier = recorded.lubeTier;
+    save.gravityTier = recorded.gravityTier;
+    save.prestige = recorded.prestige;
+    save.oxyTier = recorded.oxyTier;
+    return;
+  }
+  diverged("expected the save");
+}
+
+void Recorder::transition(const char *name) {
+  auto length = u8(SDL_min(std::strlen(name), usize(255)));
+  if(mMode == Recording) {
+    put(TagTransition);
+    put(length);
+    mData.insert(mData.end(), name, name + length);
+    return;
+  }
+  if(mMode != Replaying) {
+    return;
+  }
+  u8 recorded = 0;
+  if(!expect(TagTransition) || !get(recorded)
+  || mData.size() - mPos < recorded
+  || recorded != length || std::memcmp(&mData[mPos], name, length) != 0) {
+    diverged("went to another state");
+    return;
+  }
+  mPos += recorded;
+}
+
+bool Recorder::expect(Tag tag) {
+  if(mPos < mData.size() && Tag(mData[mPos]) == tag) {
+    ++mPos;
+    return true;
+  }
+  return false;
+}
+
+void Recorder::flush() {
+  if(mFile == nullptr || mData.empty()) {
+    return;
+  }
+  if(SDL_RWwrite(mFile, mData.data(), 1, mData.size()) != mData.size()) {
+    console::error("Could not write the recording: {}", SDL_GetError());
+    SDL_RWclose(mFile);
+    mFile = nullptr;
+    mMode = Off;
+  }
+  mData.clear();
+}
+
+void Recorder::diverged(const char *what) {
+  console::error("Replay diverged after {} frames: {}. Live input from here on.",
+    mFrames, what);
+  mMode = Off;
+}
+
+Recorder &recorder() {
+  // leaked for the same reason as the asset cache
+  static auto *sRecorder = new Recorder;
+  return *sRecorder;
+}
+
+} // namespace sbs
@@ -0,0 +1,174 @@
+#pragma once
+
+/*
+Recorder.hpp
+------------
+Input & frame timing recording, replayed to reproduce a session
+*/
+
+#include "save.hpp"
+#include <functional>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/state.hpp>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_stdinc.h>
+#include <vector>
+
+namespace sbs {
+
+/*
+Records whatever makes a session go the way it went: the events each state
+is handed in `on`, key binds, every tick's `delta`, the random seeds, the
+save the session started from & the states it went through. `--record
+<file>` writes them to a compact binary log, `--replay <file>` plays it back
+frame for frame, ignoring live input, so a reported hitch runs again under
+`sbs.perf` exactly as it did for the player.
+
+States hook in at four points:
+- a `Recorder::Listener` member, which receives the replayed input
+- `if(!recorder().event(evt)) return true;` first thing in `on`, and the same
+  through `bind` in key bind callbacks
+- `delta = recorder().frame(delta);` first thing in the tick of top-level
+  states, and of substates pushed without ticking their parent, never
+  other substates (after `FramePacer::pace`, so it sees the delta the frame
+  really ran with)
+- `recorder().delta()` in place of `delta` in the tick of substates whose
+  parent is ticked: the delta the last `frame` call returned, the recorded
+  one while replaying, where the live delta would follow the wall clock
+
+Console commands are not recorded. Mini-game inputs are, but not where in
+their frame they came, so a replay hands them all to the end of the frame.
+While replaying, saves are never written.
+*/
+class Recorder {
+public:
+  static constexpr u32 cMagic = 0x52534253; // "SBSR"
+  static constexpr u16 cVersion = 1;
+
+  /* which state the session started in, picked by the command line */
+  enum Start: u8 {
+    StartWarning,
+    StartMenu,
+    StartGame,
+    StartEnd,
+  };
+
+  /*
+  Registers a state or substate as a receiver of replayed input, the last
+  one constructed & still alive gets it. Constructing one also records the
+  state transition, under `name`.
+  */
+  class Listener {
+  public:
+    using EventFn = std::function<void(nwge::Event &evt)>;
+    using BindFn = std::function<void(u8 bind)>;
+
+    Listener(const char *name, EventFn &&onEvent = {}, BindFn &&onBind = {});
+    ~Listener();
+
+    Listener(const Listener &other) = delete;
+    Listener &operator=(const Listener &other) = delete;
+
+  private:
+    friend class Recorder;
+
+    EventFn mOnEvent;
+    BindFn mOnBind;
+  };
+
+  /* Starts writing the log, call before the first state is created. */
+  bool record(const char *path, Start start);
+  /* Loads the log, returns the state to start in. */
+  bool replay(const char *path, Start &start);
+  /* Writes out whatever is still buffered. */
+  void finish();
+
+  /* Saves stay untouched once a replay has started, even after it ends. */
+  [[nodiscard]]
+  inline bool writesSaves() const {
+    return !mReplayed;
+  }
+
+  /* False if live input should be ignored, for it is being replayed. */
+  bool event(const nwge::Event &evt);
+  /* Same as `event`, for key binds: `bind` is the state's own number. */
+  bool bind(u8 bind);
+  /* Returns the delta the frame should tick with. Replaying hands the
+     frame's input to the current listener first. */
+  f32 frame(f32 delta);
+  /* What the last `frame` call returned, for substates whose parent makes it. */
+  [[nodiscard]]
+  inline f32 delta() const {
+    return mDelta;
+  }
+
+  /* Stands in for `Rng::randomSeed`, for seeds the session depends on. */
+  u64 seed();
+  /* The save as the session loaded it, recorded or put back. */
+  void save(SavefileV3 &save);
+
+private:
+  enum Mode {
+    Off,
+    Recording,
+    Replaying,
+  };
+
+  enum Tag: u8 {
+    TagFrame,
+    TagMouseDown,
+    TagMouseUp,
+    TagMouseMotion,
+    TagMouseScroll,
+    TagBind,
+    TagSeed,
+    TagSave,
+    TagTransition,
+  };
+
+  /* buffered records are written out once there are this many bytes */
+  static constexpr usize cFlushSize = 16 << 10;
+
+  Mode mMode = Off;
+  bool mReplayed = false;
+  std::vector<char> mData;
+  /* replaying: read position in `mData` */
+  usize mPos = 0;
+  SDL_RWops *mFile = nullptr;
+  std::vector<Listener*> mListeners;
+  /* set while replayed input is handed out, so it gets through `event` */
+  bool mDispatching = false;
+  u32 mFrames = 0;
+  f32 mDelta = 0.0f;
+
+  f32 step(f32 delta);
+  void transition(const char *name);
+  void flush();
+  void diverged(const char *what);
+
+  template<typename T>
+  void put(T value) {
+    usize pos = mData.size();
+    mData.resize(pos + sizeof(T));
+    SDL_memcpy(&mData[pos], &value, sizeof(T));
+  }
+
+  template<typename T>
+  bool get(T &value) {
+    if(mData.size() - mPos < sizeof(T)) {
+      return false;
+    }
+    SDL_memcpy(&value, &mData[mPos], sizeof(T));
+    mPos += sizeof(T);
+    return true;
+  }
+
+  /* Replaying: consumes the next record if it is a `tag`. */
+  bool expect(Tag tag);
+};
+
+/* The process-wide recorder. */
+Recorder &recorder();
+
+} // namespace sbs
@@ -0,0 +1,135 @@
+#pragma once
+
+/*
+Rng.hpp
+-------
+Small deterministic random number generators
+*/
+
+#include <nwge/common/def.h>
+#include <random>
+
+namespace sbs {
+
+/*
+xoshiro128** seeded through SplitMix64. Unlike the standard distributions
+the output only depends on the seed, so a simulation replays identically on
+every platform & standard library.
+*/
+class Rng {
+public:
+  Rng(u64 seed = 0) {
+    reseed(seed);
+  }
+
+  /* A seed for when reproducibility does not matter. */
+  static u64 randomSeed() {
+    std::random_device dev;
+    return (u64(dev()) << 32) | u64(dev());
+  }
+
+  inline void reseed(u64 seed) {
+    for(auto &word: mState) {
+      seed += 0x9E3779B97F4A7C15ULL;
+      u64 mixed = seed;
+      mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+      word = u32(mixed ^ (mixed >> 31));
+    }
+  }
+
+  inline u32 next() {
+    const u32 result = rotl(mState[1] * 5, 7) * 9;
+    const u32 shifted = mState[1] << 9;
+    mState[2] ^= mState[0];
+    mState[3] ^= mState[1];
+    mState[1] ^= mState[2];
+    mState[0] ^= mState[3];
+    mState[2] ^= shifted;
+    mState[3] = rotl(mState[3], 11);
+    return result;
+  }
+
+  /* Uniformly distributed integer in [min, max]. */
+  inline s32 range(s32 min, s32 max) {
+    const u64 span = u64(s64(max) - s64(min)) + 1;
+    return s32(s64(min) + s64((u64(next()) * span) >> 32));
+  }
+
+  /* Uniformly distributed float in [0, 1). */
+  inline f32 unit() {
+    return f32(next() >> 8) * (1.0f / f32(1 << 24));
+  }
+
+private:
+  u32 mState[4];
+
+  static inline u32 rotl(u32 value, s32 bits) {
+    return (value << bits) | (value >> (32 - bits));
+  }
+};
+
+/*
+Four xoshiro128** streams stepped in lockstep, one per vector lane, for
+filling whole arrays of uniforms at once. The lanes are laid out so the
+compiler keeps them in SIMD registers; the output still only depends on
+the seed.
+*/
+class BatchRng {
+public:
+  static constexpr usize cLanes = 4;
+
+  BatchRng(u64 seed = 0) {
+    reseed(seed);
+  }
+
+  inline void reseed(u64 seed) {
+    for(usize word = 0; word < 4; ++word) {
+      for(usize lane = 0; lane < cLanes; ++lane) {
+        seed += 0x9E3779B97F4A7C15ULL;
+        u64 mixed = seed;
+        mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+        mState[word][lane] = u32(mixed ^ (mixed >> 31));
+      }
+    }
+  }
+
+  /* Fills `out` with uniformly distributed floats in [0, 1). */
+  inline void fillUnit(f32 *out, usize count) {
+    u32 values[cLanes];
+    usize i = 0;
+    for(; i + cLanes <= count; i += cLanes) {
+      next(values);
+      for(usize lane = 0; lane < cLanes; ++lane) {
+        out[i + lane] = f32(values[lane] >> 8) * (1.0f / f32(1 << 24));
+      }
+    }
+    if(i < count) {
+      next(values);
+      for(usize lane = 0; lane < count - i; ++lane) {
+        out[i + lane] = f32(values[lane] >> 8) * (1.0f / f32(1 << 24));
+      }
+    }
+  }
+
+private:
+  u32 mState[4][cLanes];
+
+  inline void next(u32 (&out)[cLanes]) {
+    auto &s0 = mState[0], &s1 = mState[1], &s2 = mState[2], &s3 = mState[3];
+    for(usize lane = 0; lane < cLanes; ++lane) {
+      const u32 mul = s1[lane] * 5;
+      out[lane] = ((mul << 7) | (mul >> 25)) * 9;
+      const u32 shifted = s1[lane] << 9;
+      s2[lane] ^= s0[lane];
+      s3[lane] ^= s1[lane];
+      s1[lane] ^= s2[lane];
+      s0[lane] ^= s3[lane];
+      s2[lane] ^= shifted;
+      s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+    }
+  }
+};
+
+} // namespace sbs
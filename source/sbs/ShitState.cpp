@@ -1,16 +1,20 @@
+#include "assets.hpp"
+#include "ConfigReloader.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
 #include "save.hpp"
+#include "Sim.hpp"
+#include "SpriteBatch.hpp"
+#include "TextRun.hpp"
 #include "ui.hpp"
 #include <cmath>
 #include <nwge/console/Command.hpp>
 #include <nwge/data/bundle.hpp>
-#include <nwge/data/store.hpp>
-#include <nwge/render/draw.hpp>
 #include <nwge/render/Texture.hpp>
-#include <nwge/render/mat.hpp>
 #include <nwge/render/window.hpp>
 #include <boost/lexical_cast.hpp>
-#include <random>
 
 using namespace nwge;
 
@@ -18,8 +22,9 @@ namespace sbs {
 
 class ShitState: public State {
 private:
-  data::Bundle mBundle;
-  render::Texture mBarsTexture;
+  Recorder::Listener mListener{"ShitState", [this](Event &evt){ on(evt); }};
+  AssetLoader mAssets;
+  Sprite mBarsTexture;
 
   static constexpr f32
     cBarFillOff = 0.001f,
@@ -27,57 +32,49 @@ private:
     cBarTextH = 0.025f;
 
   void renderBar(
-    const StringView &name,
+    const TextRun &name,
     glm::vec3 pos, glm::vec2 size, f32 progress,
     glm::vec3 color, s16 icon,
     bool warning = false
   ) const {
-    render::color(color);
-    render::enableScissor();
-    render::scissor({pos.x, pos.y}, {size.x, size.y * progress});
-    render::rect({pos.x, pos.y, pos.z - cBarFillOff}, size, mBarsTexture);
-    render::disableScissor();
+    auto &batch = spriteBatch();
+    batch.color(color);
+    batch.scissor({pos.x, pos.y}, {size.x, size.y * progress});
+    batch.rect({pos.x, pos.y, pos.z - cBarFillOff}, size, mBarsTexture);
+    batch.disableScissor();
 
-    render::color(color * cBarBgClrMult);
-    render::rect(pos, size);
+    batch.color(color * cBarBgClrMult);
+    batch.rect(pos, size);
 
-    render::color(cWindowBgColor);
-    render::rect(
+    batch.color(cWindowBgColor);
+    batch.rect(
       {pos.x - cPad, pos.y - cPad, pos.z + cBarFillOff},
       {size.x + 2*cPad, size.y + 3*cPad + cBarTextH}
     );
 
-    auto measure = mFont.measure(name, cBarTextH);
-    f32 textX = size.x / 2 - measure.x / 2 + pos.x - 3*cBarTextH/4;
+    f32 textX = size.x / 2 - name.size().x / 2 + pos.x - 3*cBarTextH/4;
     f32 textY = pos.y + size.y + cPad;
     f32 textZ = pos.z - 2*cBarFillOff;
-    drawTextWithShadow(mFont, name,
-      {textX + cBarTextH, textY, textZ},
-      cBarTextH);
-    render::rect(
+    batch.color();
+    batch.textWithShadow(name, {textX + cBarTextH, textY, textZ});
+    batch.rect(
       {textX, textY, textZ},
       {cBarTextH, cBarTextH},
       mIconsTexture,
-      {
-        {f32(icon % 2) * cIconTexUnit, f32(s16(icon / 2)) * cIconTexUnit},
-        {cIconTexUnit, cIconTexUnit}});
+      {f32(icon % 2) * cIconTexUnit, f32(s16(icon / 2)) * cIconTexUnit},
+      {cIconTexUnit, cIconTexUnit});
     if(warning) {
-      render::rect(
+      batch.rect(
         {textX, textY, textZ - cBarFillOff},
         {cBarTextH, cBarTextH},
         mIconsTexture,
-        {
-          {0, 0.5f},
-          {1.0f/8.0f, 1.0f/8.0f}});
+        {0, 0.5f},
+        {1.0f/8.0f, 1.0f/8.0f});
     }
   }
 
-  f32 mEffort = 0.0f;
-
-  static constexpr f32
-    cEffortDecay = 0.3f,
-    cEffortIncrement = 0.1f,
-    cMaxEffort = 1.0f;
+  Sim mSim{recorder().seed()};
+  bool mFixedStep = false;
 
   static constexpr f32
     cEffortBarW = 0.1f,
@@ -88,11 +85,6 @@ private:
   static constexpr glm::vec3
     cEffortBarColor{2, 2, 0};
 
-  f32 mOxy = 1.0f;
-  f32 mOxyCooldown = 0.0f;
-
-  bool mOuttaBreath = false;
-
   static constexpr f32
     cOxyBarW = 0.1f,
     cOxyBarH = 4*cOxyBarW,
@@ -103,26 +95,7 @@ private:
     cOxyBarColor{0, 1, 1},
     cOxyBarBadColor{1, 0, 0};
 
-  f32 mProgress = 0.0f;
-
-  static constexpr f32 cProgressScalar = 0.5f;
-
-  f32 mCooldown = 0.0f;
-
-  f32 mGravity = 0.0f;
-  f32 mProgressDecay = 0.9f;
-
-  void recalculateProgressDecay() {
-    mProgressDecay = mConfig.lube.base - f32(mSave.v2.lubeTier) * mConfig.lube.upgrade;
-  }
-
-  void recalculateGravity() {
-    mGravity = mConfig.gravity.base + f32(mSave.v2.gravityTier) * mConfig.gravity.upgrade;
-  }
-
-  render::Texture mBrickTexture;
-
-  f32 mBrickFall = -1.0f;
+  Sprite mBrickTexture;
 
   static constexpr f32
     cBrickX = 0.5f,
@@ -136,14 +109,14 @@ private:
     cTextY = 0.075f,
     cTextZ = 0.53f;
 
-  render::Font mFont;
-  ScratchString mScoreString;
+  Asset<render::Font> mFont;
+  TextRun mScoreText, mEffortText, mOxyText;
 
   void refreshScoreString() {
-    mScoreString = ScratchString::formatted("Score: {}", mSave.v2.score);
+    mScoreText.set(*mFont, ScratchString::formatted("Score: {}", mSave.v3.score), cTextH);
   }
 
-  render::Texture mWaterTexture;
+  Sprite mWaterTexture;
 
   static constexpr f32
     cWaterW = 1,
@@ -154,11 +127,7 @@ private:
     cWaterAlpha = 0.56f,
     cWaterZ = 0.54f;
 
-  f32 mTimer = 0.0f;
-
-  static constexpr f32 cFadeInTime = 1.0f;
-
-  render::Texture mBgTexture, mVignetteTexture;
+  Asset<render::Texture> mBgTexture, mVignetteTexture;
 
   static constexpr f32
     cBgZ = 0.6f,
@@ -166,19 +135,13 @@ private:
     cVignetteZ = 0.41f,
     cFadeZ = 0.405f;
 
-  data::Store mStore;
-
-  void save() {
-    mStore.nqSave("save.json", mSave);
-    refreshScoreString();
-  }
-
   void resetSave() {
     mSave = {};
-    save();
+    mSave.dirty = true;
+    refreshScoreString();
   }
 
-  render::Texture mIconsTexture;
+  Sprite mIconsTexture;
 
   bool mHoveringStoreIcon = false;
 
@@ -203,17 +166,27 @@ private:
       (mousePos.y > cStoreIconY && mousePos.y < cStoreIconY+cStoreIconH);
   }
 
-  Config mConfig;
+  Asset<Config> mConfig;
   Savefile mSave{};
 
+  // everything else reads the config as it goes, only the tiers' effects
+  // are cached by the sim (the store rebuilds itself)
+  ConfigReloader mConfigReloader{[this](u32 changed){
+    if((changed & (Config::LubeSection | Config::GravitySection)) != 0) {
+      mSim.recalculate(*mConfig, mSave.v3);
+    }
+  }};
+
   console::Command mLubeCommand{"sbs.lube", [this](auto &args){
     if(args.size() == 0) {
-      console::print("lube tier: {}", mSave.v2.lubeTier);
+      console::print("lube tier: {}", mSave.v3.lubeTier);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.lubeTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("lube tier: {}", mSave.v2.lubeTier);
+        mSave.v3.lubeTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        mSave.dirty = true;
+        mSim.recalculate(*mConfig, mSave.v3);
+        console::print("lube tier: {}", mSave.v3.lubeTier);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -222,12 +195,14 @@ private:
 
   console::Command mGravityCommand{"sbs.gravity", [this](auto &args){
     if(args.size() == 0) {
-      console::print("gravity tier: {}", mSave.v2.gravityTier);
+      console::print("gravity tier: {}", mSave.v3.gravityTier);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.gravityTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("gravity tier: {}", mSave.v2.gravityTier);
+        mSave.v3.gravityTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        mSave.dirty = true;
+        mSim.recalculate(*mConfig, mSave.v3);
+        console::print("gravity tier: {}", mSave.v3.gravityTier);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -236,12 +211,13 @@ private:
 
   console::Command mScoreCommand{"sbs.score", [this](auto &args){
     if(args.size() == 0) {
-      console::print("score: {}", mSave.v2.score);
+      console::print("score: {}", mSave.v3.score);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.score = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("score: {}", mSave.v2.score);
+        mSave.v3.score = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        mSave.dirty = true;
+        console::print("score: {}", mSave.v3.score);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -250,12 +226,14 @@ private:
 
   console::Command mOxyCommand{"sbs.oxyTier", [this](auto &args){
     if(args.size() == 0) {
-      console::print("oxyTier: {}", mSave.v2.oxyTier);
+      console::print("oxyTier: {}", mSave.v3.oxyTier);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.oxyTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("oxyTier: {}", mSave.v2.oxyTier);
+        mSave.v3.oxyTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        // the sim reads the oxy tier as it goes, nothing to recalculate
+        mSave.dirty = true;
+        console::print("oxyTier: {}", mSave.v3.oxyTier);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -266,113 +244,111 @@ private:
     resetSave();
   }};
 
-  f32 mWaterX = 0.0f;
-  f32 mWaterY = 0.0f;
+  console::Command mFixedStepCommand{"sbs.fixedStep", [this](){
+    mFixedStep = !mFixedStep;
+    mSim.accumulator = 0.0f;
+    console::print("fixed timestep: {}", mFixedStep ? "on" : "off");
+  }};
 
   audio::Source mBreathSource;
-  audio::Buffer mBreath;
+  Asset<audio::Buffer> mBreath;
 
   audio::Source mSfxSource;
-  audio::Buffer mSplash;
-  audio::Buffer mBuy;
-  audio::Buffer mBrokeAssMfGetAJob;
-  audio::Buffer mPop;
+  Asset<audio::Buffer> mSplash;
+  Asset<audio::Buffer> mBuy;
+  Asset<audio::Buffer> mBrokeAssMfGetAJob;
+  Asset<audio::Buffer> mPop;
   inline void play(audio::Buffer &sound) {
     mSfxSource.stop();
     mSfxSource.buffer(sound);
     mSfxSource.play();
   }
 
-  render::Texture mToiletTexture, mToiletFTexture;
+  Sprite mToiletTexture, mToiletFTexture;
 
   void renderBrick() const {
     f32 brickY;
-    if(mCooldown == 0.0) {
-      brickY = mConfig.brick.startY + mProgress * (mConfig.brick.endY - mConfig.brick.startY);
+    if(mSim.cooldown == 0.0) {
+      brickY = mConfig->brick.startY + mSim.progress * (mConfig->brick.endY - mConfig->brick.startY);
     } else {
-      brickY = mConfig.brick.endY + mBrickFall * (cBrickFallEndY - mConfig.brick.endY);
+      brickY = mConfig->brick.endY + mSim.brickFall * (cBrickFallEndY - mConfig->brick.endY);
     }
-    render::mat::push();
-    render::mat::translate({mConfig.brick.xPos, brickY, cBrickZ});
-    render::mat::rotate(M_PI/2, {0, 0, 1});
-    render::rect(
+    auto &batch = spriteBatch();
+    batch.transform({{mConfig->brick.xPos, brickY, cBrickZ}, f32(M_PI/2)});
+    batch.rect(
       {0, 0, 0},
-      {2*mConfig.brick.size, mConfig.brick.size},
+      {2*mConfig->brick.size, mConfig->brick.size},
       mBrickTexture);
-    render::mat::pop();
+    batch.clearTransform();
   }
 
   void renderToilet() const {
-    render::rect(
-      {mConfig.toilet.xPos, mConfig.toilet.yPos, cToiletZ},
-      {mConfig.toilet.size, mConfig.toilet.size},
+    auto &batch = spriteBatch();
+    batch.rect(
+      {mConfig->toilet.xPos, mConfig->toilet.yPos, cToiletZ},
+      {mConfig->toilet.size, mConfig->toilet.size},
       mToiletTexture);
-    render::rect(
-      {mConfig.shitter.xPos, mConfig.shitter.yPos, cShitterZ},
-      {mConfig.shitter.width, mConfig.shitter.height},
+    batch.rect(
+      {mConfig->shitter.xPos, mConfig->shitter.yPos, cShitterZ},
+      {mConfig->shitter.width, mConfig->shitter.height},
       mShitterTexture);
 
-    render::enableScissor();
-    render::scissor(
-      {mConfig.water.scissorX, mConfig.water.scissorY},
-      {mConfig.water.scissorW, mConfig.water.scissorH});
-    render::color({1, 1, 1, 0.5f});
-    render::rect(
-      {mWaterX, mWaterY, cWaterZ},
-      {mConfig.water.width, mConfig.water.height},
+    batch.scissor(
+      {mConfig->water.scissorX, mConfig->water.scissorY},
+      {mConfig->water.scissorW, mConfig->water.scissorH});
+    batch.color({1, 1, 1, 0.5f});
+    batch.rect(
+      {mSim.waterX, mSim.waterY, cWaterZ},
+      {mConfig->water.width, mConfig->water.height},
       mWaterTexture);
-    render::disableScissor();
+    batch.disableScissor();
 
-    render::color();
-    render::rect(
-      {mConfig.toilet.xPos, mConfig.toilet.yPos, cToiletFZ},
-      {mConfig.toilet.size, mConfig.toilet.size},
+    batch.color();
+    batch.rect(
+      {mConfig->toilet.xPos, mConfig->toilet.yPos, cToiletFZ},
+      {mConfig->toilet.size, mConfig->toilet.size},
       mToiletFTexture);
   }
 
   void renderBars() const {
     renderBar(
-      "Effort",
+      mEffortText,
       {cEffortBarX, cEffortBarY, cEffortBarZ},
       {cEffortBarW, cEffortBarH},
-      mEffort,
+      mSim.effort,
       cEffortBarColor,
       3);
     renderBar(
-      "Oxy",
+      mOxyText,
       {cOxyBarX, cOxyBarY, cOxyBarZ},
       {cOxyBarW, cOxyBarH},
-      mOxy,
-      mOuttaBreath ? cOxyBarBadColor : cOxyBarColor,
+      mSim.oxy,
+      mSim.outtaBreath ? cOxyBarBadColor : cOxyBarColor,
       2,
-      mOuttaBreath);
-    render::color();
+      mSim.outtaBreath);
+    spriteBatch().color();
   }
 
   Music mMusic;
 
-  render::Texture mShitterTexture;
-
-  render::Texture mPRTexture;
+  Sprite mShitterTexture;
 
-  std::mt19937 mRng;
-  static constexpr s32 cPRRoll = 10000;   /* maximum number randomly rolled */
-  static constexpr s32 cPRTarget = 1010;  /* the number rolled for event */
-  std::uniform_int_distribution<s32> mPRDist{-cPRRoll, cPRRoll};
-  static constexpr s32 cPRW = 2;
-  static constexpr s32 cPRH = 2;
-  std::uniform_int_distribution<s32> mPRImgDist{0, cPRW*cPRH - 1};
-
-  s32 mPRImg = 0;
+  Asset<render::Texture> mPRTexture;
 
 public:
   ShitState(Music &&music)
     : mMusic(std::move(music))
   {}
 
+  ~ShitState() override {
+    saveScheduler().flush(mSave);
+  }
+
   bool preload() override {
-    mBundle
-      .load({"sbs.bndl"})
+    SBS_PERF_SCOPE("ShitState::preload");
+    // --menu, --game & --end start here instead of the warning screen
+    SBS_PERF_MILESTONE("first preload");
+    mAssets
       .nqTexture("bars.png", mBarsTexture)
       .nqTexture("brick.png", mBrickTexture)
       .nqFont("GrapeSoda.cfn", mFont)
@@ -390,25 +366,51 @@ public:
       .nqTexture("toiletF.png", mToiletFTexture)
       .nqTexture("shitter.png", mShitterTexture)
       .nqTexture("PR.JPG"_sv, mPRTexture);
-    mStore.nqLoad("progress", mSave.v1);
-    mStore.nqLoad("save.json", mSave.v2);
+    saveScheduler().nqLoad(mSave);
     return true;
   }
 
+  static void prefetch(AssetLoader &assets) {
+    assets
+      .prefetchTexture("bars.png")
+      .prefetchTexture("brick.png")
+      .prefetchFont("GrapeSoda.cfn")
+      .prefetchTexture("water.png")
+      .prefetchTexture("bg.png")
+      .prefetchCustom<Config>("cfg.json")
+      .prefetchTexture("vignette.png")
+      .prefetchTexture("icons.png")
+      .prefetchCustom<audio::Buffer>("splash.wav")
+      .prefetchCustom<audio::Buffer>("buy.wav")
+      .prefetchCustom<audio::Buffer>("broke.wav")
+      .prefetchCustom<audio::Buffer>("pop.wav")
+      .prefetchCustom<audio::Buffer>("breath.wav")
+      .prefetchTexture("toilet.png")
+      .prefetchTexture("toiletF.png")
+      .prefetchTexture("shitter.png")
+      .prefetchTexture("PR.JPG"_sv);
+  }
+
   bool init() override {
-    mBreathSource.buffer(mBreath);
-    recalculateProgressDecay();
-    recalculateGravity();
-    refreshScoreString();
-    save();
-    if(mSave.v1.loaded) {
-      mStore.nqDelete("progress"_sv);
+    SBS_PERF_SCOPE("ShitState::init");
+    if(!mAssets.finish()) {
+      return false;
     }
+    mBreathSource.buffer(*mBreath);
+    saveScheduler().resolve(mSave);
+    mSim.recalculate(*mConfig, mSave.v3);
+    mEffortText.set(*mFont, "Effort", cBarTextH);
+    mOxyText.set(*mFont, "Oxy", cBarTextH);
+    refreshScoreString();
+    framePacer().enter(FramePacer::Gameplay);
     return true;
   }
 
   bool on(Event &evt) override {
-    if(mTimer < cFadeInTime) {
+    if(!recorder().event(evt)) {
+      return true;
+    }
+    if(mSim.fadingIn()) {
       return true;
     }
     if(evt.type == Event::MouseDown) {
@@ -416,11 +418,11 @@ public:
       if(mHoveringStoreIcon) {
         StoreData data{
           mSave,
-          mConfig,
+          *mConfig,
           mSfxSource,
-          mBuy,
-          mBrokeAssMfGetAJob,
-          mFont,
+          *mBuy,
+          *mBrokeAssMfGetAJob,
+          *mFont,
           mIconsTexture,
         };
         pushSubStatePtr(getStoreSubState(data), {
@@ -429,13 +431,7 @@ public:
         });
         return true;
       }
-      if(!mOuttaBreath
-      && mCooldown <= 0
-      && mEffort < cMaxEffort
-      && mOxy >= mConfig.oxy.min) {
-        mEffort += cEffortIncrement;
-        return true;
-      }
+      mSim.push(*mConfig);
     }
     if(evt.type == Event::MouseMotion) {
       updateHoveringStoreIcon(evt.motion.to);
@@ -444,141 +440,83 @@ public:
   }
 
   bool tick(f32 delta) override {
+    SBS_PERF_SCOPE("ShitState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
     if(mSave.dirty) {
-      save();
-    }
-
-    static bool sSplash = true;
-
-    mTimer += delta;
-    mWaterX = mConfig.water.minX - (0.5f*sinf(1+1.2*mTimer) + 1) * (mConfig.water.maxX - mConfig.water.minX);
-    mWaterY = mConfig.water.minY + (0.5f*sinf(mTimer) + 1) * (mConfig.water.maxY - mConfig.water.minY);
-    if(mPRImg > 0) {
-      mPRImg = -1;
-    } else {
-      s32 roll = mPRDist(mRng);
-      if(roll == cPRTarget) {
-        mPRImg = mPRImgDist(mRng);
-      }
-    }
-
-    if(mTimer < cFadeInTime) {
-      return true;
-    }
-
-    if(mEffort > 0) {
-      mEffort -= cEffortDecay * delta;
-      if(mOuttaBreath || mCooldown > 0) {
-        mEffort -= delta;
-      }
-      if(mEffort < 0) {
-        mEffort = 0;
-      }
+      refreshScoreString();
     }
+    saveScheduler().tick(delta, mSave);
+    mConfigReloader.tick(delta, *mConfig);
 
-    if(mOxy < 1.0f) {
-      f32 regen = mConfig.oxy.regenFast;
-      if(mOuttaBreath && mSave.v2.oxyTier < 1) {
-        regen = mConfig.oxy.regenSlow;
-      }
-      mOxy += regen * delta;
+    SimEvents events;
+    if(mFixedStep) {
+      events = mSim.advance(delta, *mConfig, mSave.v3);
     } else {
-      mOuttaBreath = false;
+      events = mSim.tick(delta, *mConfig, mSave.v3);
     }
-
-    mOxy -= mEffort * mConfig.oxy.drain * delta;
-    if(mOxy <= 0) {
-      if(!mOuttaBreath) {
-        mBreathSource.play();
-      }
-      mOuttaBreath = true;
-      mOxy = 0;
+    if(events.outOfBreath) {
+      mBreathSource.play();
     }
-
-    if(mProgress < 1) {
-      mProgress += mEffort * cProgressScalar * delta;
-      if(mProgress >= mConfig.gravity.threshold) {
-        mProgress += mGravity * delta;
-      }
-      if(mProgress >= 1) {
-        mCooldown = 1.0f;
-        mBrickFall = 0.0f;
-        play(mPop);
-        ++mSave.v2.score;
-        save();
-      } else if(mProgress > 0) {
-        mProgress -= mProgressDecay * delta;
-        if(mProgress < 0) {
-          mProgress = 0;
-        }
-      }
-    } else if(mCooldown > 0) {
-      mCooldown -= delta;
-    } else {
-      mProgress = 0;
-      mCooldown = 0;
-      mBrickFall = -1.0f;
-      recalculateProgressDecay();
-      recalculateGravity();
-      sSplash = true;
+    if(events.scored) {
+      play(*mPop);
+      mSave.addScore(1);
+      refreshScoreString();
     }
-
-    if(mBrickFall >= 0) {
-      mBrickFall += mConfig.brick.fallSpeed * delta;
-      if(mBrickFall >= mWaterY && sSplash) {
-        play(mSplash);
-        sSplash = false;
-      }
+    if(events.splash) {
+      play(*mSplash);
     }
     return true;
   }
 
   void render() const override {
-    render::color();
-    render::rect({0, 0, cBgZ}, {1, 1}, mBgTexture);
+    SBS_PERF_SCOPE("ShitState::render");
+    auto &batch = spriteBatch();
+    batch.color();
+    batch.rect({0, 0, cBgZ}, {1, 1}, *mBgTexture);
 
-    if(mCooldown <= 0 || mBrickFall >= 0) {
+    if(mSim.cooldown <= 0 || mSim.brickFall >= 0) {
       renderBrick();
     }
 
     renderToilet();
     renderBars();
 
-    auto measure = mFont.measure(mScoreString, cTextH);
-    f32 textX = cTextX - measure.x;
-    drawTextWithShadow(mFont, mScoreString, {textX, cTextY, cTextZ}, cTextH);
+    f32 textX = cTextX - mScoreText.size().x;
+    batch.textWithShadow(mScoreText, {textX, cTextY, cTextZ});
 
     if(mHoveringStoreIcon) {
-      render::color(cHoverColor);
+      batch.color(cHoverColor);
     }
-    render::rect(
+    batch.rect(
       {cStoreIconX, cStoreIconY, cStoreIconZ},
       {cStoreIconW, cStoreIconH},
       mIconsTexture,
-      {
-        {cStoreIconTexX, cStoreIconTexY},
-        {cStoreIconTexW, cStoreIconTexH}});
-
-    if(mPRImg > 0) {
-      render::color();
-      f32 uvX = f32(mPRImg % cPRW) / f32(cPRW);
-      f32 uvY = f32(s32(mPRImg / cPRW)) / f32(cPRH);
-      render::rect(
+      {cStoreIconTexX, cStoreIconTexY},
+      {cStoreIconTexW, cStoreIconTexH});
+
+    if(mSim.prImg > 0) {
+      batch.color();
+      f32 uvX = f32(mSim.prImg % Sim::cPRW) / f32(Sim::cPRW);
+      f32 uvY = f32(s32(mSim.prImg / Sim::cPRW)) / f32(Sim::cPRH);
+      batch.rect(
         {0, 0, cPRZ},
         {1, 1},
-        mPRTexture, {
-          {uvX, uvY},
-          {1.0f/cPRW, 1.0f/cPRH}});
+        *mPRTexture,
+        {uvX, uvY},
+        {1.0f/Sim::cPRW, 1.0f/Sim::cPRH});
     }
 
-    f32 vignetteAlpha = fmaxf(mEffort, 1.0f - mOxy);
-    render::color({1, 1, 1, vignetteAlpha});
-    render::rect({0, 0, cVignetteZ}, {1, 1}, mVignetteTexture);
+    f32 vignetteAlpha = fmaxf(mSim.effort, 1.0f - mSim.oxy);
+    batch.color({1, 1, 1, vignetteAlpha});
+    batch.rect({0, 0, cVignetteZ}, {1, 1}, *mVignetteTexture);
 
-    if(mTimer < cFadeInTime) {
-      render::color({0, 0, 0, 1.0f - mTimer / cFadeInTime});
-      render::rect({0, 0, cFadeZ}, {1,1});
+    if(mSim.fadingIn()) {
+      batch.color({0, 0, 0, 1.0f - mSim.timer / Sim::cFadeInTime});
+      batch.rect({0, 0, cFadeZ}, {1,1});
     }
+
+    batch.flush();
   }
 };
 
@@ -586,4 +524,8 @@ State *getShitState(Music &&music) {
   return new ShitState(std::move(music));
 }
 
+void prefetchShitState(AssetLoader &assets) {
+  ShitState::prefetch(assets);
+}
+
 } // namespace sbs
@@ -0,0 +1,204 @@
+#pragma once
+
+/*
+Sim.hpp
+-------
+The gameplay simulation, without any audio or rendering
+*/
+
+#include "config.hpp"
+#include "Rng.hpp"
+#include "save.hpp"
+#include <cmath>
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* what happened during a simulation step, for the shell to react to */
+struct SimEvents {
+  bool scored = false;      // a brick made it through
+  bool outOfBreath = false; // oxy just ran out
+  bool splash = false;      // the falling brick just hit the water
+
+  inline SimEvents &operator|=(const SimEvents &other) {
+    scored = scored || other.scored;
+    outOfBreath = outOfBreath || other.outOfBreath;
+    splash = splash || other.splash;
+    return *this;
+  }
+};
+
+/*
+Everything `ShitState` simulates, driven purely by the config & the save.
+Holds no references & never allocates, so tools can run as many copies as
+they like. Scoring is reported through `SimEvents`, the caller decides what
+the save does with it.
+*/
+struct Sim {
+  static constexpr f32
+    cFadeInTime = 1.0f,
+    cEffortDecay = 0.3f,
+    cEffortIncrement = 0.1f,
+    cMaxEffort = 1.0f,
+    cProgressScalar = 0.5f,
+    cBrickCooldown = 1.0f;
+
+  /* step used by `advance` */
+  static constexpr f32 cFixedStep = 1.0f / 120.0f;
+  /* `advance` drops time rather than spiral after a long hitch */
+  static constexpr s32 cMaxSteps = 30;
+
+  static constexpr s32
+    cPRRoll = 10000,  // maximum number randomly rolled
+    cPRTarget = 1010, // the number rolled for event
+    cPRW = 2,
+    cPRH = 2;
+
+  Rng rng;
+
+  f32 timer = 0.0f;
+  f32 effort = 0.0f;
+  f32 oxy = 1.0f;
+  bool outtaBreath = false;
+  f32 progress = 0.0f;
+  f32 cooldown = 0.0f;
+  f32 brickFall = -1.0f;
+  bool splashPending = true;
+  f32 progressDecay = 0.9f;
+  f32 gravity = 0.0f;
+  f32 waterX = 0.0f;
+  f32 waterY = 0.0f;
+  s32 prImg = 0;
+
+  /* leftover time not yet consumed by `advance` */
+  f32 accumulator = 0.0f;
+  /* bricks scored since construction */
+  u32 bricks = 0;
+
+  Sim(u64 seed = 0)
+    : rng(seed)
+  {}
+
+  /* Picks up the tiers from the save. Runs automatically after each brick. */
+  inline void recalculate(const Config &config, const SavefileV3 &save) {
+    progressDecay = config.lube.base - f32(save.lubeTier) * config.lube.upgrade;
+    gravity = config.gravity.base + f32(save.gravityTier) * config.gravity.upgrade;
+  }
+
+  [[nodiscard]]
+  inline bool fadingIn() const {
+    return timer < cFadeInTime;
+  }
+
+  /* A click on the toilet. Returns whether it went into the effort. */
+  inline bool push(const Config &config) {
+    if(fadingIn()
+    || outtaBreath
+    || cooldown > 0
+    || effort >= cMaxEffort
+    || oxy < config.oxy.min) {
+      return false;
+    }
+    effort += cEffortIncrement;
+    return true;
+  }
+
+  /* Advances by exactly `delta`. */
+  inline SimEvents tick(f32 delta, const Config &config, const SavefileV3 &save) {
+    SimEvents events;
+
+    timer += delta;
+    waterX = config.water.minX - (0.5f*sinf(1+1.2f*timer) + 1) * (config.water.maxX - config.water.minX);
+    waterY = config.water.minY + (0.5f*sinf(timer) + 1) * (config.water.maxY - config.water.minY);
+    if(prImg > 0) {
+      prImg = -1;
+    } else if(rng.range(-cPRRoll, cPRRoll) == cPRTarget) {
+      prImg = rng.range(0, cPRW*cPRH - 1);
+    }
+
+    if(fadingIn()) {
+      return events;
+    }
+
+    if(effort > 0) {
+      effort -= cEffortDecay * delta;
+      if(outtaBreath || cooldown > 0) {
+        effort -= delta;
+      }
+      if(effort < 0) {
+        effort = 0;
+      }
+    }
+
+    if(oxy < 1.0f) {
+      f32 regen = config.oxy.regenFast;
+      if(outtaBreath && save.oxyTier < 1) {
+        regen = config.oxy.regenSlow;
+      }
+      oxy += regen * delta;
+    } else {
+      outtaBreath = false;
+    }
+
+    oxy -= effort * config.oxy.drain * delta;
+    if(oxy <= 0) {
+      events.outOfBreath = !outtaBreath;
+      outtaBreath = true;
+      oxy = 0;
+    }
+
+    if(progress < 1) {
+      progress += effort * cProgressScalar * delta;
+      if(progress >= config.gravity.threshold) {
+        progress += gravity * delta;
+      }
+      if(progress >= 1) {
+        cooldown = cBrickCooldown;
+        brickFall = 0.0f;
+        ++bricks;
+        events.scored = true;
+      } else if(progress > 0) {
+        progress -= progressDecay * delta;
+        if(progress < 0) {
+          progress = 0;
+        }
+      }
+    } else if(cooldown > 0) {
+      cooldown -= delta;
+    } else {
+      progress = 0;
+      cooldown = 0;
+      brickFall = -1.0f;
+      recalculate(config, save);
+      splashPending = true;
+    }
+
+    if(brickFall >= 0) {
+      brickFall += config.brick.fallSpeed * delta;
+      if(brickFall >= waterY && splashPending) {
+        events.splash = true;
+        splashPending = false;
+      }
+    }
+    return events;
+  }
+
+  /* Advances by `delta` in `cFixedStep` increments, so the outcome does not
+     depend on the frame rate. */
+  inline SimEvents advance(f32 delta, const Config &config, const SavefileV3 &save) {
+    SimEvents events;
+    accumulator += delta;
+    s32 steps = 0;
+    while(accumulator >= cFixedStep && steps < cMaxSteps) {
+      events |= tick(cFixedStep, config, save);
+      accumulator -= cFixedStep;
+      ++steps;
+    }
+    if(steps == cMaxSteps) {
+      accumulator = 0.0f;
+    }
+    return events;
+  }
+};
+
+} // namespace sbs
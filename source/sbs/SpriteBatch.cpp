@@ -0,0 +1,241 @@
+#include "SpriteBatch.hpp"
+#include <algorithm>
+#include <nwge/render/draw.hpp>
+#include <nwge/render/mat.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+SpriteBatch::Command &SpriteBatch::push(Kind kind, glm::vec3 pos) {
+  auto &cmd = mCommands.emplace_back();
+  cmd.kind = kind;
+  cmd.transform = mTransform;
+  cmd.order = u32(mCommands.size() - 1);
+  cmd.pos = pos;
+  cmd.color = mColor;
+  cmd.source = nullptr;
+  return cmd;
+}
+
+void SpriteBatch::rect(glm::vec3 pos, glm::vec2 size) {
+  auto &cmd = push(KindRect, pos);
+  cmd.size = size;
+}
+
+void SpriteBatch::rect(
+  glm::vec3 pos, glm::vec2 size,
+  const render::Texture &texture,
+  glm::vec2 uvPos, glm::vec2 uvSize
+) {
+  auto &cmd = push(KindTexturedRect, pos);
+  cmd.size = size;
+  cmd.source = &texture;
+  cmd.uvPos = uvPos;
+  cmd.uvSize = uvSize;
+}
+
+void SpriteBatch::text(const TextRun &text, glm::vec3 pos) {
+  auto &cmd = push(KindText, pos);
+  cmd.source = &text;
+}
+
+void SpriteBatch::textWithShadow(const TextRun &text, glm::vec3 pos) {
+  auto &cmd = push(KindTextWithShadow, pos);
+  cmd.source = &text;
+}
+
+void SpriteBatch::scissor(glm::vec2 pos, glm::vec2 size) {
+  closeSegment();
+  mScissor = true;
+  mScissorPos = pos;
+  mScissorSize = size;
+}
+
+void SpriteBatch::disableScissor() {
+  closeSegment();
+  mScissor = false;
+}
+
+void SpriteBatch::closeSegment() {
+  usize begin = mSegments.empty() ? 0 : mSegments.back().end;
+  if(mCommands.size() == begin) {
+    return;
+  }
+  mSegments.push_back({mCommands.size(), mScissor, mScissorPos, mScissorSize});
+}
+
+void SpriteBatch::flush() {
+  closeSegment();
+
+  if(mShowOverdraw) {
+    render::clear({0, 0, 0});
+  }
+  usize begin = 0;
+  for(const auto &segment: mSegments) {
+    if(segment.scissor) {
+      render::enableScissor();
+      render::scissor(segment.pos, segment.size);
+    }
+    drawSegment(begin, segment.end);
+    if(segment.scissor) {
+      render::disableScissor();
+    }
+    begin = segment.end;
+    ++mStats.segments;
+  }
+  render::color();
+  ++mStats.flushes;
+
+  mCommands.clear();
+  mSegments.clear();
+  mTransforms.clear();
+  mColor = {1, 1, 1, 1};
+  mTransform = -1;
+  mScissor = false;
+}
+
+bool SpriteBatch::isFullScreen(const Command &cmd) {
+  return cmd.kind == KindRect
+    && cmd.transform < 0
+    && cmd.pos.x <= 0 && cmd.pos.y <= 0
+    && cmd.pos.x + cmd.size.x >= 1 && cmd.pos.y + cmd.size.y >= 1;
+}
+
+glm::vec2 SpriteBatch::extent(const Command &cmd) const {
+  if(cmd.kind == KindText || cmd.kind == KindTextWithShadow) {
+    return static_cast<const TextRun*>(cmd.source)->size();
+  }
+  return cmd.size;
+}
+
+void SpriteBatch::drawSegment(usize begin, usize end) {
+  // back to front (higher Z is further away), then by texture & color so
+  // equal layers draw without state changes, then in submission order
+  std::sort(mCommands.begin() + begin, mCommands.begin() + end,
+    [this](const Command &lhs, const Command &rhs){
+      f32 lhsDepth = lhs.depth(mTransforms);
+      f32 rhsDepth = rhs.depth(mTransforms);
+      if(lhsDepth != rhsDepth) {
+        return lhsDepth > rhsDepth;
+      }
+      if(lhs.source != rhs.source) {
+        return lhs.source < rhs.source;
+      }
+      return lhs.order < rhs.order;
+    });
+
+  // nothing under the last opaque full-screen rect can show through
+  usize first = begin;
+  for(usize i = end; i-- > begin;) {
+    if(isFullScreen(mCommands[i]) && mCommands[i].color.a >= 1.0f) {
+      first = i;
+      break;
+    }
+  }
+  mStats.occluded += u32(first - begin);
+
+  const void *lastTexture = nullptr;
+  bool haveColor = false;
+  glm::vec4 lastColor{};
+  for(usize i = first; i < end; ++i) {
+    const auto &cmd = mCommands[i];
+    if(cmd.color.a <= 0.0f) {
+      ++mStats.culled;
+      continue;
+    }
+    glm::vec2 size = extent(cmd);
+    if(cmd.transform < 0) {
+      // clipped to the screen, transformed commands are counted whole
+      glm::vec2 lo = glm::max(glm::vec2(cmd.pos), glm::vec2(0, 0));
+      glm::vec2 hi = glm::min(glm::vec2(cmd.pos) + size, glm::vec2(1, 1));
+      size = glm::max(hi - lo, glm::vec2(0, 0));
+    }
+    mStats.coverage += size.x * size.y;
+
+    if(mShowOverdraw) {
+      drawOverdraw(cmd);
+    } else {
+      draw(cmd, lastTexture, haveColor, lastColor);
+    }
+  }
+}
+
+void SpriteBatch::draw(
+  const Command &cmd,
+  const void *&lastTexture, bool &haveColor, glm::vec4 &lastColor
+) {
+  bool isText = cmd.kind == KindText || cmd.kind == KindTextWithShadow;
+  // shadowed text sets its own colors
+  if(cmd.kind != KindTextWithShadow
+  && (!haveColor || cmd.color != lastColor)) {
+    render::color(cmd.color);
+    lastColor = cmd.color;
+    haveColor = true;
+    ++mStats.colorChanges;
+  }
+  if(cmd.kind == KindTexturedRect && cmd.source != lastTexture) {
+    lastTexture = cmd.source;
+    ++mStats.textureSwitches;
+  }
+  if(cmd.transform >= 0) {
+    const auto &transform = mTransforms[cmd.transform];
+    render::mat::push();
+    render::mat::translate(transform.translate);
+    render::mat::rotate(transform.rotation, {0, 0, 1});
+    ++mStats.transforms;
+  }
+
+  switch(cmd.kind) {
+  case KindRect:
+    render::rect(cmd.pos, cmd.size);
+    break;
+  case KindTexturedRect:
+    render::rect(cmd.pos, cmd.size,
+      *static_cast<const render::Texture*>(cmd.source),
+      {cmd.uvPos, cmd.uvSize});
+    break;
+  case KindText:
+    static_cast<const TextRun*>(cmd.source)->draw(cmd.pos);
+    break;
+  case KindTextWithShadow:
+    static_cast<const TextRun*>(cmd.source)->drawWithShadow(cmd.pos, cmd.color);
+    // drawTextWithShadow leaves the render color changed
+    haveColor = false;
+    break;
+  }
+
+  if(cmd.transform >= 0) {
+    render::mat::pop();
+  }
+  if(isText) {
+    ++mStats.texts;
+  } else {
+    ++mStats.sprites;
+  }
+}
+
+/* Every command as a flat rect over its bounds, so with plain alpha blending
+   a pixel under n layers ends up 1 - (7/8)^n white. */
+void SpriteBatch::drawOverdraw(const Command &cmd) {
+  static constexpr f32 cLayerAlpha = 0.125f;
+  if(cmd.transform >= 0) {
+    const auto &transform = mTransforms[cmd.transform];
+    render::mat::push();
+    render::mat::translate(transform.translate);
+    render::mat::rotate(transform.rotation, {0, 0, 1});
+  }
+  render::color({1, 1, 1, cLayerAlpha});
+  render::rect(cmd.pos, extent(cmd));
+  if(cmd.transform >= 0) {
+    render::mat::pop();
+  }
+}
+
+SpriteBatch &spriteBatch() {
+  // leaked for the same reason as the asset cache
+  static auto *sBatch = new SpriteBatch;
+  return *sBatch;
+}
+
+} // namespace sbs
@@ -0,0 +1,186 @@
+#pragma once
+
+/*
+SpriteBatch.hpp
+---------------
+Sorted, deferred rect drawing
+*/
+
+#include "assets.hpp"
+#include "TextRun.hpp"
+#include <nwge/common/def.h>
+#include <nwge/console/Command.hpp>
+#include <nwge/render/Texture.hpp>
+#include <vector>
+
+namespace sbs {
+
+/*
+Collects rects & text for a frame and draws them back to front, grouped by
+texture & color, so the engine sees as few state changes as possible. The
+API mirrors `render::` — color & transform are sticky until changed.
+
+Changing the scissor region closes the current segment: everything recorded
+before it is sorted & drawn separately from everything after it.
+
+Being deferred, it also composites before drawing anything: commands with
+zero alpha are dropped and everything under an opaque untextured
+full-screen rect is skipped.
+
+Only ShitState draws through the batch, so `sbs.drawCalls` & the
+`sbs.overdraw` heat map cover the game screen alone. The menu & the store
+still draw straight to `render::`, their layers (the menu's vignette, the
+store's dim) are not counted.
+*/
+class SpriteBatch {
+public:
+  struct Transform {
+    glm::vec3 translate{};
+    f32 rotation = 0.0f; // around Z, applied after the translation
+  };
+
+  struct Stats {
+    u32 flushes = 0;
+    u32 segments = 0;
+    u32 sprites = 0;
+    u32 texts = 0;
+    u32 colorChanges = 0;
+    u32 textureSwitches = 0;
+    u32 transforms = 0;
+    u32 culled = 0;   // zero alpha
+    u32 occluded = 0; // under an opaque full-screen rect
+    /* screen area covered by everything drawn, in screens */
+    f32 coverage = 0.0f;
+  };
+
+  void color(glm::vec4 color = {1, 1, 1, 1}) {
+    mColor = color;
+  }
+
+  void color(glm::vec3 color) {
+    mColor = {color, 1};
+  }
+
+  void transform(const Transform &transform) {
+    mTransforms.push_back(transform);
+    mTransform = s32(mTransforms.size() - 1);
+  }
+
+  void clearTransform() {
+    mTransform = -1;
+  }
+
+  void rect(glm::vec3 pos, glm::vec2 size);
+  void rect(
+    glm::vec3 pos, glm::vec2 size,
+    const nwge::render::Texture &texture,
+    glm::vec2 uvPos = {0, 0}, glm::vec2 uvSize = {1, 1});
+  /* `uvPos` & `uvSize` are relative to the sprite. */
+  inline void rect(
+    glm::vec3 pos, glm::vec2 size,
+    const Sprite &sprite,
+    glm::vec2 uvPos = {0, 0}, glm::vec2 uvSize = {1, 1}
+  ) {
+    rect(pos, size, *sprite.texture, sprite.mapPos(uvPos), sprite.mapSize(uvSize));
+  }
+  void text(const TextRun &text, glm::vec3 pos);
+  void textWithShadow(const TextRun &text, glm::vec3 pos);
+
+  void scissor(glm::vec2 pos, glm::vec2 size);
+  void disableScissor();
+
+  /* Draws everything recorded so far, call once at the end of `render`. */
+  void flush();
+
+  [[nodiscard]]
+  inline const Stats &stats() const {
+    return mStats;
+  }
+
+private:
+  enum Kind: u8 {
+    KindRect,
+    KindTexturedRect,
+    KindText,
+    KindTextWithShadow,
+  };
+
+  struct Command {
+    Kind kind;
+    s32 transform;
+    u32 order;
+    glm::vec3 pos;
+    glm::vec2 size;
+    glm::vec4 color;
+    const void *source; // texture or text run
+    glm::vec2 uvPos;
+    glm::vec2 uvSize;
+
+    [[nodiscard]]
+    inline f32 depth(const std::vector<Transform> &transforms) const {
+      return transform < 0 ? pos.z : pos.z + transforms[transform].translate.z;
+    }
+  };
+
+  struct Segment {
+    usize end;
+    bool scissor;
+    glm::vec2 pos;
+    glm::vec2 size;
+  };
+
+  std::vector<Command> mCommands;
+  std::vector<Segment> mSegments;
+  std::vector<Transform> mTransforms;
+  glm::vec4 mColor{1, 1, 1, 1};
+  s32 mTransform = -1;
+  bool mScissor = false;
+  glm::vec2 mScissorPos{};
+  glm::vec2 mScissorSize{};
+
+  Stats mStats;
+  /* draws the heat map instead of the frame, see `sbs.overdraw` */
+  bool mShowOverdraw = false;
+
+  Command &push(Kind kind, glm::vec3 pos);
+  void closeSegment();
+  void drawSegment(usize begin, usize end);
+  void draw(const Command &cmd, const void *&lastTexture, bool &haveColor, glm::vec4 &lastColor);
+  void drawOverdraw(const Command &cmd);
+
+  [[nodiscard]]
+  static bool isFullScreen(const Command &cmd);
+  [[nodiscard]]
+  glm::vec2 extent(const Command &cmd) const;
+
+  nwge::console::Command mStatsCommand{"sbs.drawCalls", [this]{
+    if(mStats.flushes == 0) {
+      nwge::console::print("nothing drawn yet");
+      return;
+    }
+    auto perFlush = [this](u32 count){
+      return f32(count) / f32(mStats.flushes);
+    };
+    nwge::console::print("per flush: {} segments, {} rects, {} texts, "
+      "{} color changes, {} texture switches, {} transforms",
+      perFlush(mStats.segments), perFlush(mStats.sprites),
+      perFlush(mStats.texts), perFlush(mStats.colorChanges),
+      perFlush(mStats.textureSwitches), perFlush(mStats.transforms));
+    nwge::console::print("  composited away: {} culled, {} occluded; "
+      "{} screens covered",
+      perFlush(mStats.culled), perFlush(mStats.occluded),
+      mStats.coverage / f32(mStats.flushes));
+    mStats = {};
+  }};
+
+  nwge::console::Command mOverdrawCommand{"sbs.overdraw", [this]{
+    mShowOverdraw = !mShowOverdraw;
+    nwge::console::print("overdraw heat map of the game screen: {} (every layer over a pixel "
+      "lifts it 1/8 of the way to white)", mShowOverdraw ? "on" : "off");
+  }};
+};
+
+/* The process-wide sprite batch. */
+SpriteBatch &spriteBatch();
+
+} // namespace sbs
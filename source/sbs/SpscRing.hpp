@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+SpscRing.hpp
+------------
+Fixed-size lock-free single-producer/single-consumer queue
+*/
+
+#include <array>
+#include <atomic>
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/*
+One thread pushes, one thread pops, neither ever blocks. When the consumer
+falls `N` items behind, pushes fail and are counted instead, so a stall
+shows up as a warning rather than unbounded memory.
+*/
+template<typename T, usize N>
+class SpscRing {
+  static_assert(N != 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  /* Producer side. */
+  bool push(const T &value) {
+    usize head = mHead.load(std::memory_order_relaxed);
+    if(head - mTail.load(std::memory_order_acquire) == N) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    mItems[head % N] = value;
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side. */
+  bool pop(T &out) {
+    usize tail = mTail.load(std::memory_order_relaxed);
+    if(tail == mHead.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = mItems[tail % N];
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Pushes which failed since the last call. */
+  usize takeDropped() {
+    return mDropped.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::array<T, N> mItems{};
+  // on separate cache lines, each side only writes its own
+  alignas(64) std::atomic<usize> mHead{0};
+  alignas(64) std::atomic<usize> mTail{0};
+  std::atomic<usize> mDropped{0};
+};
+
+} // namespace sbs
@@ -1,5 +1,9 @@
 #include "config.hpp"
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
+#include "TextRun.hpp"
 #include "ui.hpp"
 #include <nwge/render/draw.hpp>
 #include <nwge/render/window.hpp>
@@ -12,20 +16,21 @@ namespace sbs {
 
 class StoreSubState: public SubState {
 private:
+  Recorder::Listener mListener{"StoreSubState", [this](Event &evt){ on(evt); }};
   StoreData mData;
 
   [[nodiscard]]
   bool hasItem(const StoreItem &item) const {
-    if(mData.save.v2.prestige < item.prestige) {
+    if(mData.save.v3.prestige < item.prestige) {
       return false;
     }
     switch(item.kind) {
     case sbs::StoreItem::Lube:
-      return mData.save.v2.lubeTier >= item.argument;
+      return mData.save.v3.lubeTier >= item.argument;
     case sbs::StoreItem::Gravity:
-      return mData.save.v2.gravityTier >= item.argument;
+      return mData.save.v3.gravityTier >= item.argument;
     case sbs::StoreItem::Oxy:
-      return mData.save.v2.oxyTier >= item.argument;
+      return mData.save.v3.oxyTier >= item.argument;
     default:
       return false;
     }
@@ -80,15 +85,76 @@ private:
     cItemIconW = cItemIconH,
     cItemTextX = cItemIconX+cItemIconH+cPad;
 
+  TextRun mTitleText, mOwnedText;
+  Array<TextRun> mPriceText;
+
+  /* Indices into `Config::store` of the items shown at the current
+     prestige, in display order: row `n` shows `mRows[n]`. */
+  Array<u32> mRows;
+  s16 mRowsPrestige = 0;
+  u32 mStoreRevision = 0;
+
+  /* Rebuilds everything kept per item, after the config was reloaded. */
+  void rebuildItems() {
+    const auto &store = mData.config.store;
+    mStoreRevision = mData.config.storeRevision;
+    mPriceText = {store.size()};
+    for(usize i = 0; i < mPriceText.size(); ++i) {
+      mPriceText[i].set(mData.font,
+        ScratchString::formatted("Price: {}", store[i].price),
+        cItemNameTextH);
+    }
+    if(mPurchaseFloat >= 0 && usize(mPurchaseFloat) >= store.size()) {
+      mPurchaseFloat = cNoPurchaseFloat;
+    }
+    indexRows();
+  }
+
+  void indexRows() {
+    const auto &store = mData.config.store;
+    mRowsPrestige = mData.save.v3.prestige;
+    usize count = 0;
+    for(const auto &item: store) {
+      if(item.prestige <= mRowsPrestige) {
+        ++count;
+      }
+    }
+    mRows = {count};
+    usize row = 0;
+    for(usize i = 0; i < store.size(); ++i) {
+      if(store[i].prestige <= mRowsPrestige) {
+        mRows[row++] = u32(i);
+      }
+    }
+  }
+
+  /* Catches up with reloads & prestige changes. */
+  void syncItems() {
+    if(mStoreRevision != mData.config.storeRevision) {
+      rebuildItems();
+    } else if(mRowsPrestige != mData.save.v3.prestige) {
+      indexRows();
+    } else {
+      return;
+    }
+    framePacer().dirty();
+    mScrollTarget = SDL_min(mScrollTarget, maxScroll());
+    mScroll = SDL_min(mScroll, maxScroll());
+    updateItemHover();
+  }
+
+  /* row under the cursor, -1 if none */
   s32 mItemHover = -1;
+  glm::vec2 mMousePos{-1, -1};
 
-  void updateItemHover(glm::vec2 mousePos) {
-    if(mousePos.x < cItemAreaX || mousePos.x >= cItemAreaX+cItemAreaW
-    || mousePos.y < cItemAreaY || mousePos.y >= cItemAreaY+cItemAreaH) {
+  void updateItemHover() {
+    if(mMousePos.x < cItemAreaX || mMousePos.x >= cItemAreaX+cItemAreaW
+    || mMousePos.y < cItemAreaY || mMousePos.y >= cItemAreaY+cItemAreaH) {
       mItemHover = -1;
       return;
     }
-    mItemHover = s32((mousePos.y + f32(mScroll) * cScrollScalar - cItemAreaY) / cItemH);
+    auto row = s32((mMousePos.y + mScroll - cItemAreaY) / cItemH);
+    mItemHover = usize(row) < mRows.size() ? row : -1;
   }
 
   static constexpr s32
@@ -106,7 +172,8 @@ private:
     cPurchaseFloatZ = 0.034f,
     cPurchaseFloatH = 0.034f;
 
-  void acquire(const StoreItem &item) {
+  void acquire(u32 index) {
+    const auto &item = mData.config.store[index];
     if(hasItem(item)) {
       mPurchaseFloat = cAlreadyOwnedFloat;
       mPurchaseFloatTimer = 0.0f;
@@ -116,7 +183,7 @@ private:
       return;
     }
 
-    if(mData.save.v2.score < item.price) {
+    if(mData.save.v3.score < item.price) {
       // broke ahh
       mPurchaseFloat = cInsufficientFundsFloat;
       mPurchaseFloatTimer = 0.0f;
@@ -126,90 +193,106 @@ private:
       return;
     }
 
-    mData.save.v2.score -= item.price;
+    mData.save.v3.score -= item.price;
     mData.save.dirty = true;
     switch(item.kind) {
     case sbs::StoreItem::Lube:
-      mData.save.v2.lubeTier = SDL_max(mData.save.v2.lubeTier, item.argument);
+      mData.save.v3.lubeTier = SDL_max(mData.save.v3.lubeTier, item.argument);
       break;
     case sbs::StoreItem::Gravity:
-      mData.save.v2.gravityTier = SDL_max(mData.save.v2.gravityTier, item.argument);
+      mData.save.v3.gravityTier = SDL_max(mData.save.v3.gravityTier, item.argument);
       break;
     case sbs::StoreItem::Oxy:
-      mData.save.v2.oxyTier = SDL_max(mData.save.v2.oxyTier, item.argument);
+      mData.save.v3.oxyTier = SDL_max(mData.save.v3.oxyTier, item.argument);
       break;
     case sbs::StoreItem::EndGame:
+      // the end screen rewrites the save, make sure ours lands first
+      saveScheduler().flush(mData.save);
       swapStatePtr(getEndState());
       return;
     case sbs::StoreItem::None:
       NWGE_UNREACHABLE("Invalid StoreItem");
     }
-    mPurchaseFloat = mItemHover;
+    mPurchaseFloat = s32(index);
     mItemHover = -1;
     mData.source.stop();
     mData.source.buffer(mData.buySound);
     mData.source.play();
   }
 
-  s32 mScroll = 0;
+  /* how far the list is scrolled down, eased towards the target */
+  f32 mScroll = 0.0f;
+  f32 mScrollTarget = 0.0f;
 
-  static constexpr s32
-    cMinScroll = 0,
-    cMaxScroll = 7;
-  static constexpr f32 cScrollScalar = 0.05f;
+  static constexpr f32
+    cScrollStep = cItemH / 2,
+    cScrollSpeed = 15.0f;
 
-  const StoreItem *getHoveredItem() {
-    if(mItemHover < 0) {
-      return nullptr;
-    }
-    s32 displayIdx = 0;
-    for(const auto &item: mData.config.store) {
-      if(item.prestige > mData.save.v2.prestige) {
-        continue;
-      }
-      if(displayIdx++ == mItemHover) {
-        return &item;
-      }
-    }
-    return nullptr;
+  [[nodiscard]]
+  f32 maxScroll() const {
+    return SDL_max(0.0f, f32(mRows.size()) * cItemH - cItemAreaH);
   }
 
 public:
+  /* Keeps whatever pacing the game underneath has: its parent is still
+     ticked & drawn, so the screen never goes static. */
   StoreSubState(StoreData data)
-    : mData(data)
-  {}
+    : mData(data),
+      mTitleText(data.font, "Store", cTitleTextH),
+      mOwnedText(data.font, "Owned", cItemNameTextH)
+  {
+    rebuildItems();
+  }
 
   bool on(Event &evt) override {
+    if(!recorder().event(evt)) {
+      return true;
+    }
+    syncItems();
+    framePacer().dirty();
     if(evt.type == Event::MouseDown) {
       if((evt.click.pos.x < cWindowX || evt.click.pos.x > cWindowX+cWindowW)
       || (evt.click.pos.y < cWindowY || evt.click.pos.y > cWindowY+cWindowH)) {
         popSubState();
         return true;
       }
-      updateItemHover(evt.click.pos);
-      if(mItemHover == -1 || usize(mItemHover) >= mData.config.store.size()) {
-        return true;
-      }
-      const auto *item = getHoveredItem();
-      if(item == nullptr) {
+      mMousePos = evt.click.pos;
+      updateItemHover();
+      if(mItemHover == -1) {
         return true;
       }
       mPurchaseFloatAnchor = evt.click.pos;
       mPurchaseFloatTimer = 0.0f;
-      acquire(*item);
+      acquire(mRows[mItemHover]);
       return true;
     }
     if(evt.type == Event::MouseMotion) {
-      updateItemHover(evt.motion.to);
+      mMousePos = evt.motion.to;
+      updateItemHover();
     }
     if(evt.type == Event::MouseScroll) {
-      mScroll = SDL_clamp(mScroll + evt.scroll, cMinScroll, cMaxScroll);
+      mScrollTarget = SDL_clamp(mScrollTarget + f32(evt.scroll) * cScrollStep,
+        0.0f, maxScroll());
     }
     return true;
   }
 
-  bool tick(f32 delta) override {
+  bool tick([[maybe_unused]] f32 liveDelta) override {
+    SBS_PERF_SCOPE("StoreSubState::tick");
+    // the parent's, so a replay eases & hovers exactly like the recording
+    f32 delta = recorder().delta();
+    syncItems();
+    if(mScroll != mScrollTarget) {
+      framePacer().dirty();
+      f32 step = (mScrollTarget - mScroll) * SDL_min(1.0f, delta * cScrollSpeed);
+      mScroll = SDL_fabsf(mScrollTarget - mScroll - step) < 0.0005f
+        ? mScrollTarget
+        : mScroll + step;
+      // the list moved under the cursor
+      updateItemHover();
+    }
     if(mPurchaseFloat != cNoPurchaseFloat) {
+      framePacer().dirty();
       mPurchaseFloatTimer += delta;
       if(mPurchaseFloatTimer >= cPurchaseFloatLifetime) {
         mPurchaseFloat = cNoPurchaseFloat;
@@ -219,29 +302,34 @@ public:
   }
 
   void render() const override {
+    SBS_PERF_SCOPE("StoreSubState::render");
     render::color(cBgColor);
     render::rect({0, 0, cBgZ}, {1, 1});
 
     render::enableScissor();
     render::scissor({cItemAreaX, cItemAreaY}, {cItemAreaW, cItemAreaH});
 
+    // only the rows at least partly inside the item area, none if the
+    // config was reloaded since the last tick
+    auto firstRow = usize(mScroll / cItemH);
+    auto endRow = SDL_min(mRows.size(), usize((mScroll + cItemAreaH) / cItemH) + 1);
+    if(mStoreRevision != mData.config.storeRevision) {
+      endRow = 0;
+    }
     bool owned;
     f32 baseY;
-    s32 displayIdx = 0;
-    for(usize i = 0; i < mData.config.store.size(); ++i) {
+    for(usize row = firstRow; row < endRow; ++row) {
+      u32 i = mRows[row];
       const auto &item = mData.config.store[i];
-      if(item.prestige > mData.save.v2.prestige) {
-        continue;
-      }
       owned = hasItem(item);
-      baseY = cItemY + f32(displayIdx++) * cItemH - f32(mScroll) * cScrollScalar;
+      baseY = cItemY + f32(row) * cItemH - mScroll;
       static constexpr f32 cNameOff = cPad;
       static constexpr f32 cDescOff = cNameOff+ cItemNameTextH;
       static constexpr f32 cPriceOff = cDescOff + cItemDescTextH;
 
       if(owned) {
         render::color(cItemOwnedBgColor);
-      } else if(mItemHover == s32(i)) {
+      } else if(mItemHover == s32(row)) {
         render::color(cItemHoverBgColor);
       } else {
         render::color(cItemBgColor);
@@ -250,18 +338,17 @@ public:
 
       if(owned) {
         render::color(cItemOwnedTextColor);
-      } else if(mItemHover == s32(i)) {
+      } else if(mItemHover == s32(row)) {
         render::color(cItemIconHoverColor);
       } else {
         render::color(cItemTextColor);
       }
-      render::rect(
+      drawSprite(
         {cItemIconX, baseY+cPad, cItemTextZ},
         {cItemIconW, cItemIconH},
         mData.icons,
-        {
-          {0.5f + f32(item.icon % 2) / 4.0f, f32(item.icon / 2) / 4.0f},
-          {1.0f/4.0f, 1.0f/4.0f}});
+        {0.5f + f32(item.icon % 2) / 4.0f, f32(item.icon / 2) / 4.0f},
+        {1.0f/4.0f, 1.0f/4.0f});
       if(owned) {
         render::color(cItemOwnedTextColor);
       } else {
@@ -276,14 +363,9 @@ public:
         {cItemTextX, baseY + cDescOff, cItemTextZ},
         cItemDescTextH);
       if(owned) {
-        drawTextWithShadow(mData.font, "Owned",
-          {cItemTextX, baseY + cPriceOff, cItemTextZ},
-          cItemNameTextH);
+        mOwnedText.drawWithShadow({cItemTextX, baseY + cPriceOff, cItemTextZ});
       } else {
-        ScratchString text = ScratchString::formatted("Price: {}", item.price);
-        drawTextWithShadow(mData.font, text,
-          {cItemTextX, baseY + cPriceOff, cItemTextZ},
-          cItemNameTextH);
+        mPriceText[i].drawWithShadow({cItemTextX, baseY + cPriceOff, cItemTextZ});
       }
     }
 
@@ -294,24 +376,20 @@ public:
       {cWindowX, cWindowY, cWindowBgZ},
       {cWindowW, cWindowH});
 
-    auto measure = mData.font.measure("Store", cTitleTextH);
-    f32 textX = 0.5f - measure.x / 2 - cStoreIconW / 2;
-    drawTextWithShadow(mData.font,
-      "Store",
-      {textX+cStoreIconW, cTitleTextY, cTitleTextZ},
-      cTitleTextH);
-    render::rect(
+    f32 textX = 0.5f - mTitleText.size().x / 2 - cStoreIconW / 2;
+    mTitleText.drawWithShadow({textX+cStoreIconW, cTitleTextY, cTitleTextZ});
+    drawSprite(
       {textX, cStoreIconY, cStoreIconZ},
       {cStoreIconW, cStoreIconH},
       mData.icons,
-      {
-        {cStoreIconTexX, cStoreIconTexY},
-        {cStoreIconTexW, cStoreIconTexH}
-      });
+      {cStoreIconTexX, cStoreIconTexY},
+      {cStoreIconTexW, cStoreIconTexH});
 
     glm::vec4 color;
 
-    if(mPurchaseFloat != cNoPurchaseFloat) {
+    bool floatValid = mPurchaseFloat < 0
+      || usize(mPurchaseFloat) < mData.config.store.size();
+    if(mPurchaseFloat != cNoPurchaseFloat && floatValid) {
       f32 alpha = mPurchaseFloatTimer / cPurchaseFloatLifetime;
       glm::vec3 pos = {mPurchaseFloatAnchor, cPurchaseFloatZ};
       pos.y -= alpha * cPurchaseFloatDistance;
@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+TextRun.hpp
+-----------
+Text with its layout measured once
+*/
+
+#include "ui.hpp"
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/render/draw.hpp>
+#include <nwge/render/Font.hpp>
+#include <SDL2/SDL_stdinc.h>
+#include <string>
+
+namespace sbs {
+
+/*
+A string which only gets measured again when it actually changes. Owns a
+copy of the text, so it may be set from a temporary `ScratchString`.
+
+The measurement is taken at the height passed to `set`. Other heights are
+derived by scaling it, fonts lay out linearly in the text height.
+*/
+class TextRun {
+public:
+  TextRun() = default;
+
+  TextRun(const nwge::render::Font &font, const nwge::StringView &text, f32 height) {
+    set(font, text, height);
+  }
+
+  /* Returns whether the text was laid out again. */
+  bool set(const nwge::render::Font &font, const nwge::StringView &text, f32 height) {
+    if(mFont == &font && mHeight == height && same(text)) {
+      return false;
+    }
+    mFont = &font;
+    mHeight = height;
+    mText.assign(text.begin(), text.size());
+    mSize = font.measure(this->text(), height);
+    return true;
+  }
+
+  [[nodiscard]]
+  inline bool present() const {
+    return mFont != nullptr;
+  }
+
+  [[nodiscard]]
+  inline nwge::StringView text() const {
+    return {mText.data(), mText.size()};
+  }
+
+  [[nodiscard]]
+  inline glm::vec2 size() const {
+    return mSize;
+  }
+
+  [[nodiscard]]
+  inline glm::vec2 size(f32 height) const {
+    return mSize * (height / mHeight);
+  }
+
+  /* Draws in the current render color. */
+  inline void draw(glm::vec3 pos) const {
+    mFont->draw(text(), pos, mHeight);
+  }
+
+  inline void draw(glm::vec3 pos, f32 height) const {
+    mFont->draw(text(), pos, height);
+  }
+
+  /* Same as `drawTextWithShadow`. */
+  inline void drawWithShadow(glm::vec3 pos, glm::vec4 color = {1, 1, 1, 1}) const {
+    drawTextWithShadow(*mFont, text(), pos, mHeight, color);
+  }
+
+private:
+  const nwge::render::Font *mFont = nullptr;
+  std::string mText;
+  f32 mHeight = 0.0f;
+  glm::vec2 mSize{};
+
+  [[nodiscard]]
+  inline bool same(const nwge::StringView &text) const {
+    return text.size() == mText.size()
+      && (text.size() == 0
+        || SDL_memcmp(text.begin(), mText.data(), text.size()) == 0);
+  }
+};
+
+} // namespace sbs
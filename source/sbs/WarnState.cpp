@@ -1,5 +1,10 @@
+#include "assets.hpp"
+#include "FramePacer.hpp"
 #include "Music.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
+#include "TextRun.hpp"
 #include <nwge/data/bundle.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/draw.hpp>
@@ -13,12 +18,12 @@ namespace sbs {
 
 class WarnState: public State {
 private:
-  data::Bundle mBundle;
-  render::Font mFont;
+  Recorder::Listener mListener{"WarnState", [this](Event &evt){ on(evt); }};
+  AssetLoader mAssets;
+  Asset<render::Font> mFont;
+  TextRun mWarningRun, mWarningTextRun, mContinueRun;
   audio::Source mBoomSource;
-  audio::Buffer mBoomBuffer;
-
-  render::Texture mLogoTexture;
+  Asset<audio::Buffer> mBoomBuffer;
 
   struct Warnings {
     String<> warning;
@@ -46,8 +51,7 @@ private:
         return false;
       }
 
-      std::random_device randDev;
-      std::mt19937 randGen(randDev());
+      std::mt19937 randGen(u32(recorder().seed()));
       std::uniform_int_distribution<usize> randDist(0, array.size()-1);
       const auto &warnV = array[randDist(randGen)];
       if(!warnV.isString()) {
@@ -85,39 +89,57 @@ private:
     cContinueTextFadeInEnd = 6.0f,
     cFadeOutTime = 1.0f;
 
-  Music mMusic;
-
 public:
   bool preload() override {
-    mBundle
-      .load({"sbs.bndl"})
+    SBS_PERF_SCOPE("WarnState::preload");
+    // the window is up by then; --menu, --game & --end start elsewhere,
+    // every one of those states marks it too
+    SBS_PERF_MILESTONE("first preload");
+    // the first stage of the boot: only what this screen shows, the boom
+    // included as it goes off a second in. The logo & the music are left
+    // to the intro's load
+    mAssets
       .nqFont("GrapeSoda.cfn", mFont)
-      .nqCustom("boom.wav", mBoomBuffer)
-      .nqCustom("warnings.json", mWarnings)
-      .nqTexture("logo1.png", mLogoTexture);
-    mBoomBuffer.label("boom buffer");
+      .nqCustom("boom.wav", mBoomBuffer);
+    mAssets.bundle().nqCustom("warnings.json", mWarnings);
+    mBoomBuffer->label("boom buffer");
     mBoomSource.label("boom source");
-    mMusic.nq(mBundle);
     return true;
   }
 
   bool init() override {
-    mBoomSource.buffer(mBoomBuffer);
+    SBS_PERF_SCOPE("WarnState::init");
+    if(!mAssets.finish()) {
+      return false;
+    }
+    mBoomSource.buffer(*mBoomBuffer);
+    mWarningRun.set(*mFont, "WARNING", cBigTextH);
+    mWarningTextRun.set(*mFont, mWarnings.warning, cSmallTextH);
+    mContinueRun.set(*mFont, "Click to continue", cContinueTextH);
+    framePacer().enter(FramePacer::Menu);
     return true;
   }
 
   bool on(Event &evt) override {
+    if(!recorder().event(evt)) {
+      return true;
+    }
     if(mTimer < cContinueTextFadeInBegin || mFadeOutTimer >= 0.0f) {
       return true;
     }
     if(evt.type == Event::MouseDown) {
       mFadeOutTimer = 0.0f;
+      framePacer().dirty();
     }
     return true;
   }
 
   bool tick(f32 delta) override {
+    SBS_PERF_SCOPE("WarnState::tick");
+    framePacer().pace();
+    delta = recorder().frame(delta);
     if(mFadeOutTimer >= 0.0f) {
+      framePacer().dirty();
       mFadeOutTimer += delta;
       if(mFadeOutTimer >= cFadeOutTime) {
         auto today = Date::today();
@@ -128,7 +150,7 @@ public:
             "The game is no longer available starting 2025-01-01.");
           return false;
         }
-        swapStatePtr(getIntroState(std::move(mLogoTexture), std::move(mMusic)));
+        swapStatePtr(getIntroState(Music{}));
         return true;
       }
       return true;
@@ -145,26 +167,36 @@ public:
       mBoomSource.play();
     }
 
+    // the text only changes when the next line appears, then while the
+    // continue prompt fades in; after that it is held until a click
+    if(!mBigText) {
+      framePacer().wakeIn(cBigTextTime - mTimer);
+    } else if(!mSmallText) {
+      framePacer().wakeIn(cSmallTextTime - mTimer);
+    } else if(mTimer < cContinueTextFadeInBegin) {
+      framePacer().wakeIn(cContinueTextFadeInBegin - mTimer);
+    } else if(mTimer < cContinueTextFadeInEnd) {
+      framePacer().dirty();
+    }
     return true;
   }
 
   void render() const override {
+    SBS_PERF_SCOPE("WarnState::render");
     render::clear({0, 0, 0});
 
     if(mBigText) {
-      auto measure = mFont.measure("WARNING", cBigTextH);
-      f32 textX = 0.5f - measure.x / 2;
+      f32 textX = 0.5f - mWarningRun.size().x / 2;
       render::color(cBigTextColor);
-      mFont.draw("WARNING", {textX, cBigTextY, 0.5f}, cBigTextH);
+      mWarningRun.draw({textX, cBigTextY, 0.5f});
     } else {
       return;
     }
 
     if(mSmallText) {
-      auto measure = mFont.measure(mWarnings.warning, cSmallTextH);
-      f32 textX = 0.5f - measure.x / 2;
+      f32 textX = 0.5f - mWarningTextRun.size().x / 2;
       render::color(cSmallTextColor);
-      mFont.draw(mWarnings.warning, {textX, cSmallTextY, 0.5f}, cSmallTextH);
+      mWarningTextRun.draw({textX, cSmallTextY, 0.5f});
     } else {
       return;
     }
@@ -173,14 +205,13 @@ public:
       return;
     }
 
-    auto measure = mFont.measure("Click to continue", cContinueTextH);
-    f32 textX = cContinueTextX - measure.x;
+    f32 textX = cContinueTextX - mContinueRun.size().x;
     f32 alpha = 1.0f;
     if(mTimer < cContinueTextFadeInEnd) {
       alpha = (mTimer - cContinueTextFadeInBegin) / (cContinueTextFadeInEnd - cContinueTextFadeInBegin);
     }
     render::color({1, 1, 1, alpha});
-    mFont.draw("Click to continue", {textX, cContinueTextY, 0.5f}, cContinueTextH);
+    mContinueRun.draw({textX, cContinueTextY, 0.5f});
 
     if(mFadeOutTimer >= 0.0f) {
       render::color({0, 0, 0, mFadeOutTimer});
@@ -0,0 +1,574 @@
+#include "assets.hpp"
+#include "Animation.hpp"
+#include <nwge/console.hpp>
+#include <nwge/console/Command.hpp>
+#include <nwge/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace nwge;
+
+namespace sbs {
+
+namespace {
+
+/* unreferenced entries survive this many state loads before being evicted */
+constexpr u32 cKeepGenerations = 4;
+
+/*
+Sprite regions & animation frames packed by the bundle plugin, see
+`pack_atlas` in source/bndl/plug.py:
+
+  {"pages": ["atlas0.png", "michael.sheet0.png"],
+   "regions": [{"name": "brick.png", "page": 0, "uv": [x, y, w, h]}],
+   "animations": [{"name": "michael.gif",
+                   "frames": [{"page": 1, "uv": [x, y, w, h], "time": t}]}],
+   "textures": [{"name": "bg.png", "size": [w, h]}]}
+
+Tables written before animations were packed have no `animations`, and
+those written before texture sizes were recorded have no `textures`.
+*/
+struct Atlas {
+  struct Region {
+    usize page;
+    glm::vec2 uvPos;
+    glm::vec2 uvSize;
+  };
+
+  struct Frame {
+    Region region;
+    f32 time;
+  };
+
+  bool loaded = false;
+  std::vector<std::string> pages;
+  std::unordered_map<std::string, Region> regions;
+  std::unordered_map<std::string, std::vector<Frame>> animations;
+  /* pixel size of every texture in the bundle, pages included, for the dump */
+  std::unordered_map<std::string, glm::ivec2> textureSizes;
+
+  /* the file until it has been decoded & why decoding failed, if it did */
+  Array<char> raw;
+  const char *error = nullptr;
+
+  bool parseRegion(const json::Object &object, Region &out) const {
+    const auto *pageV = object.get("page");
+    const auto *uvV = object.get("uv");
+    if(pageV == nullptr || !pageV->isNumber()
+    || uvV == nullptr || !uvV->isArray() || uvV->array().size() != 4) {
+      return false;
+    }
+    const auto &uv = uvV->array();
+    out = {
+      usize(pageV->number()),
+      {f32(uv[0].number()), f32(uv[1].number())},
+      {f32(uv[2].number()), f32(uv[3].number())},
+    };
+    return out.page < pages.size();
+  }
+
+  bool read(data::RW &file) {
+    raw = {usize(file.size())};
+    if(!file.read(raw.view())) {
+      error = "I/O error";
+    }
+    return true;
+  }
+
+  /* Runs on a worker, so failures are only reported by `finish`. */
+  void decode() {
+    if(error != nullptr) {
+      return;
+    }
+    auto res = json::parse(raw.view());
+    if(res.error != json::OK || !res.value->isObject()) {
+      error = "Invalid JSON";
+      return;
+    }
+    const auto &root = res.value->object();
+    const auto *pagesV = root.get("pages");
+    const auto *regionsV = root.get("regions");
+    if(pagesV == nullptr || !pagesV->isArray()
+    || regionsV == nullptr || !regionsV->isArray()) {
+      error = "Missing `pages` or `regions`";
+      return;
+    }
+
+    for(const auto &pageV: pagesV->array()) {
+      if(!pageV.isString()) {
+        error = "Invalid page";
+        return;
+      }
+      StringView page = pageV.string();
+      pages.emplace_back(page.begin(), page.size());
+    }
+
+    for(const auto &regionV: regionsV->array()) {
+      if(!regionV.isObject()) {
+        continue;
+      }
+      const auto &object = regionV.object();
+      const auto *nameV = object.get("name");
+      Region region;
+      if(nameV == nullptr || !nameV->isString() || !parseRegion(object, region)) {
+        error = "Invalid region";
+        return;
+      }
+      StringView name = nameV->string();
+      regions[std::string{name.begin(), name.size()}] = region;
+    }
+
+    const auto *animationsV = root.get("animations");
+    if(animationsV != nullptr && animationsV->isArray()) {
+      for(const auto &animationV: animationsV->array()) {
+        if(!animationV.isObject()) {
+          continue;
+        }
+        const auto &object = animationV.object();
+        const auto *nameV = object.get("name");
+        const auto *framesV = object.get("frames");
+        if(nameV == nullptr || !nameV->isString()
+        || framesV == nullptr || !framesV->isArray() || framesV->array().empty()) {
+          error = "Invalid animation";
+          return;
+        }
+        std::vector<Frame> frames;
+        for(const auto &frameV: framesV->array()) {
+          Frame frame;
+          const auto *timeV = frameV.isObject() ? frameV.object().get("time") : nullptr;
+          if(timeV == nullptr || !timeV->isNumber() || timeV->number() <= 0
+          || !parseRegion(frameV.object(), frame.region)) {
+            error = "Invalid animation frame";
+            return;
+          }
+          frame.time = f32(timeV->number());
+          frames.push_back(frame);
+        }
+        StringView name = nameV->string();
+        animations[std::string{name.begin(), name.size()}] = std::move(frames);
+      }
+    }
+
+    const auto *texturesV = root.get("textures");
+    if(texturesV != nullptr && texturesV->isArray()) {
+      for(const auto &textureV: texturesV->array()) {
+        const auto *nameV = textureV.isObject() ? textureV.object().get("name") : nullptr;
+        const auto *sizeV = textureV.isObject() ? textureV.object().get("size") : nullptr;
+        if(nameV == nullptr || !nameV->isString()
+        || sizeV == nullptr || !sizeV->isArray() || sizeV->array().size() != 2) {
+          error = "Invalid texture size";
+          return;
+        }
+        const auto &size = sizeV->array();
+        StringView name = nameV->string();
+        textureSizes[std::string{name.begin(), name.size()}] = {
+          s32(size[0].number()), s32(size[1].number())};
+      }
+    }
+
+    loaded = true;
+  }
+
+  /* A broken table only costs the atlas, the standalone files still work. */
+  bool finish() {
+    raw = {};
+    if(error != nullptr) {
+      console::error("Could not load atlas table: {}.", error);
+      return true;
+    }
+    console::note("Loaded atlas table: {} regions & {} animations on {} pages.",
+      regions.size(), animations.size(), pages.size());
+    return true;
+  }
+
+  [[nodiscard]]
+  const Region *find(const StringView &name) const {
+    if(!loaded) {
+      return nullptr;
+    }
+    auto iter = regions.find(std::string{name.begin(), name.size()});
+    if(iter == regions.end()) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+
+  [[nodiscard]]
+  const std::vector<Frame> *findAnimation(const StringView &name) const {
+    if(!loaded) {
+      return nullptr;
+    }
+    auto iter = animations.find(std::string{name.begin(), name.size()});
+    if(iter == animations.end()) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+
+  [[nodiscard]]
+  const glm::ivec2 *findTextureSize(const StringView &name) const {
+    if(!loaded) {
+      return nullptr;
+    }
+    auto iter = textureSizes.find(std::string{name.begin(), name.size()});
+    if(iter == textureSizes.end()) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+};
+
+class AssetCache {
+public:
+  u32 generation = 0;
+  /* atlas tables by bundle path, pinned for the lifetime of the process */
+  std::unordered_map<std::string, Asset<Atlas>> atlases;
+
+  detail::AssetEntry *find(const StringView &kind, const StringView &key) {
+    auto iter = mEntries.find(mapKey(kind, key));
+    if(iter == mEntries.end()) {
+      return nullptr;
+    }
+    if(failed(*iter->second)) {
+      // a miss, so the load is retried; whoever still holds the broken entry
+      // keeps it until they let go
+      mFailed.push_back(std::move(iter->second));
+      mEntries.erase(iter);
+      return nullptr;
+    }
+    ++mHits;
+    return iter->second.get();
+  }
+
+  void insert(std::unique_ptr<detail::AssetEntry> &&entry) {
+    ++mMisses;
+    if(entry->prefetched) {
+      ++mPrefetched;
+    }
+    auto key = mapKey(entry->kind, entry->key);
+    mEntries[key] = std::move(entry);
+  }
+
+  void claim(detail::AssetEntry &entry) {
+    entry.prefetched = false;
+    ++mPrefetchHits;
+    if(entry.loadMicros >= 0) {
+      mSavedMicros += entry.loadMicros;
+    } else {
+      ++mSavedUnknown;
+    }
+  }
+
+  /* Drops unreferenced entries not used in the last `keep` generations, and
+     unreferenced ones which failed to load right away. */
+  usize evict(u32 keep) {
+    usize count = 0;
+    std::erase_if(mFailed, [](const auto &entry){
+      return entry->refs <= 0;
+    });
+    for(auto iter = mEntries.begin(); iter != mEntries.end();) {
+      const auto &entry = *iter->second;
+      if(entry.pending) {
+        // its loader still points at it
+        ++iter;
+      } else if(entry.refs <= 0
+      && (failed(entry) || generation - entry.lastUse >= keep)) {
+        if(entry.prefetched) {
+          ++mPrefetchWasted;
+        }
+        iter = mEntries.erase(iter);
+        ++count;
+      } else {
+        ++iter;
+      }
+    }
+    return count;
+  }
+
+  void dump() const {
+    s64 knownBytes = 0;
+    s64 textureBytes = 0;
+    usize unknown = 0;
+    console::note("{} resident assets (generation {}, {} hits, {} misses):",
+      mEntries.size(), generation, mHits, mMisses);
+    for(const auto &[mapKey, entry]: mEntries) {
+      const auto *size = textureSize(*entry);
+      if(entry->bytes >= 0) {
+        knownBytes += entry->bytes;
+        console::print("  {} {}: {} refs, {} bytes, last used {} loads ago",
+          entry->kind, entry->key, entry->refs, entry->bytes,
+          generation - entry->lastUse);
+      } else if(size != nullptr) {
+        // uploaded as RGBA8
+        s64 bytes = s64(size->x) * size->y * 4;
+        textureBytes += bytes;
+        console::print("  {} {}: {} refs, {}x{}, {} bytes, last used {} loads ago",
+          entry->kind, entry->key, entry->refs, size->x, size->y, bytes,
+          generation - entry->lastUse);
+      } else {
+        ++unknown;
+        console::print("  {} {}: {} refs, decoded by engine, last used {} loads ago",
+          entry->kind, entry->key, entry->refs,
+          generation - entry->lastUse);
+      }
+    }
+    console::print("{} bytes in custom entries, {} bytes in textures, "
+      "{} engine-decoded entries of unknown size",
+      knownBytes, textureBytes, unknown);
+    usize hitRate = mPrefetched == 0 ? 0 : mPrefetchHits * 100 / mPrefetched;
+    console::print("{} prefetched, {} claimed ({}%), {} evicted unused",
+      mPrefetched, mPrefetchHits, hitRate, mPrefetchWasted);
+    console::print("prefetching saved {} us of custom decoding & {} engine-decoded loads",
+      mSavedMicros, mSavedUnknown);
+  }
+
+private:
+  std::unordered_map<std::string, std::unique_ptr<detail::AssetEntry>> mEntries;
+  /* taken out of `mEntries` by a retry while still referenced */
+  std::vector<std::unique_ptr<detail::AssetEntry>> mFailed;
+  usize mHits = 0;
+  usize mMisses = 0;
+  usize mPrefetched = 0;
+  usize mPrefetchHits = 0;
+  usize mPrefetchWasted = 0;
+  /* load time of claimed custom entries, which their states didn't wait for */
+  s64 mSavedMicros = 0;
+  usize mSavedUnknown = 0;
+
+  console::Command mCommand{"sbs.assets", [this](auto &args){
+    if(args.size() == 1 && args[0] == "evict"_sv) {
+      console::print("evicted {} assets", evict(0));
+      return;
+    }
+    dump();
+  }};
+
+  static bool failed(const detail::AssetEntry &entry) {
+    return !entry.pending && !entry.loaded;
+  }
+
+  /* Looked up in the atlas table of the entry's bundle, keys being
+     `bundle/name`. */
+  const glm::ivec2 *textureSize(const detail::AssetEntry &entry) const {
+    if(entry.kind != "texture"_sv) {
+      return nullptr;
+    }
+    StringView key = entry.key;
+    usize slash = key.size();
+    while(slash > 0 && key.begin()[slash - 1] != '/') {
+      --slash;
+    }
+    if(slash == 0) {
+      return nullptr;
+    }
+    auto iter = atlases.find(std::string{key.begin(), slash - 1});
+    if(iter == atlases.end() || !iter->second.present()) {
+      return nullptr;
+    }
+    return iter->second->findTextureSize(
+      StringView{key.begin() + slash, key.size() - slash});
+  }
+
+  static std::string mapKey(const StringView &kind, const StringView &key) {
+    std::string out{kind.begin(), kind.size()};
+    out += '|';
+    out.append(key.begin(), key.size());
+    return out;
+  }
+};
+
+/* Deliberately leaked: cached GPU objects must never be destroyed after the
+   engine has torn down its context at exit. */
+AssetCache &cache() {
+  static auto *sCache = new AssetCache;
+  return *sCache;
+}
+
+} // namespace
+
+namespace detail {
+
+AssetEntry *findAsset(const StringView &kind, const StringView &key) {
+  return cache().find(kind, key);
+}
+
+void insertAsset(std::unique_ptr<AssetEntry> &&entry) {
+  cache().insert(std::move(entry));
+}
+
+void touchAsset(AssetEntry &entry) {
+  entry.lastUse = cache().generation;
+}
+
+void claimPrefetched(AssetEntry &entry) {
+  cache().claim(entry);
+}
+
+} // namespace detail
+
+AssetLoader::AssetLoader(const StringView &bundle)
+  : mPath(bundle)
+{
+  auto &assets = cache();
+  ++assets.generation;
+  assets.evict(cKeepGenerations);
+}
+
+AssetLoader::~AssetLoader() {
+  // the state never got to `init`, so whatever it enqueued may not have
+  // loaded; the next loader asking for it retries
+  for(auto *entry: mPending) {
+    entry->pending = false;
+  }
+}
+
+AssetLoader &AssetLoader::nqTexture(const StringView &name, Asset<render::Texture> &out) {
+  if(lookup("texture", name, out)) {
+    return *this;
+  }
+  auto entry = std::make_unique<detail::TypedAssetEntry<render::Texture>>();
+  prepare(*entry, "texture", name);
+  bundle().nqTexture(name, entry->value);
+  out.assign(entry.get());
+  detail::insertAsset(std::move(entry));
+  return *this;
+}
+
+AssetLoader &AssetLoader::nqFont(const StringView &name, Asset<render::Font> &out) {
+  if(lookup("font", name, out)) {
+    return *this;
+  }
+  auto entry = std::make_unique<detail::TypedAssetEntry<render::Font>>();
+  prepare(*entry, "font", name);
+  bundle().nqFont(name, entry->value);
+  out.assign(entry.get());
+  detail::insertAsset(std::move(entry));
+  return *this;
+}
+
+AssetLoader &AssetLoader::nqTexture(const StringView &name, Sprite &out) {
+  out.uvPos = {0, 0};
+  out.uvSize = {1, 1};
+  auto iter = cache().atlases.find(std::string{mPath.begin(), mPath.size()});
+  if(iter != cache().atlases.end() && iter->second.present()) {
+    const auto &atlas = *iter->second;
+    const auto *region = atlas.find(name);
+    if(region != nullptr) {
+      out.uvPos = region->uvPos;
+      out.uvSize = region->uvSize;
+      const auto &page = atlas.pages[region->page];
+      return nqTexture(StringView{page.data(), page.size()}, out.texture);
+    }
+  }
+  return nqTexture(name, out.texture);
+}
+
+AssetLoader &AssetLoader::nqAnimation(const StringView &name, Animation &out) {
+  out.mFrames.clear();
+  out.mFallback = {};
+  out.mTime = 0.0f;
+  out.mPlaying = true;
+  auto iter = cache().atlases.find(std::string{mPath.begin(), mPath.size()});
+  if(iter != cache().atlases.end() && iter->second.present()) {
+    const auto &atlas = *iter->second;
+    const auto *frames = atlas.findAnimation(name);
+    if(frames != nullptr) {
+      f32 end = 0.0f;
+      out.mFrames.reserve(frames->size());
+      for(const auto &frame: *frames) {
+        end += frame.time;
+        auto &outFrame = out.mFrames.emplace_back();
+        outFrame.sprite.uvPos = frame.region.uvPos;
+        outFrame.sprite.uvSize = frame.region.uvSize;
+        outFrame.end = end;
+        const auto &page = atlas.pages[frame.region.page];
+        nqTexture(StringView{page.data(), page.size()}, outFrame.sprite.texture);
+      }
+      return *this;
+    }
+  }
+  return nqCustom(name, out.mFallback);
+}
+
+AssetLoader &AssetLoader::prefetchTexture(const StringView &name) {
+  // resolved like a sprite so entries packed into the atlas prefetch their
+  // page rather than a standalone file nobody asks for
+  Sprite discard;
+  mPrefetching = true;
+  nqTexture(name, discard);
+  mPrefetching = false;
+  return *this;
+}
+
+AssetLoader &AssetLoader::prefetchFont(const StringView &name) {
+  Asset<render::Font> discard;
+  mPrefetching = true;
+  nqFont(name, discard);
+  mPrefetching = false;
+  return *this;
+}
+
+AssetLoader &AssetLoader::prefetchAnimation(const StringView &name) {
+  Animation discard;
+  mPrefetching = true;
+  nqAnimation(name, discard);
+  mPrefetching = false;
+  return *this;
+}
+
+bool AssetLoader::finish() {
+  SBS_PERF_SCOPE("AssetLoader::finish");
+  mJobs.wait();
+  for(auto *entry: mPending) {
+    entry->loaded = true;
+    entry->pending = false;
+  }
+  mPending.clear();
+  bool ok = true;
+  for(auto *entry: mSplit) {
+    entry->loaded = entry->finish();
+    ok = entry->loaded && ok;
+  }
+  mSplit.clear();
+  return ok;
+}
+
+data::Bundle &AssetLoader::bundle() {
+  if(!mOpened) {
+    mBundle.load({mPath});
+    mOpened = true;
+    requestAtlas();
+  }
+  return mBundle;
+}
+
+void AssetLoader::requestAtlas() {
+  // loaded along with whatever the first state asks for, so every state
+  // after it can resolve sprites to the atlas
+  auto key = std::string{mPath.begin(), mPath.size()};
+  if(cache().atlases.count(key) != 0) {
+    return;
+  }
+  if(!mBundle.has("atlas.json"_sv)) {
+    // not packed by the bundle plugin, most likely a modded install: the
+    // empty handle keeps every sprite on its standalone file
+    console::note("{} has no atlas table, sprites load standalone.", mPath);
+    cache().atlases[key];
+    return;
+  }
+  bool prefetching = mPrefetching;
+  mPrefetching = false;
+  nqCustom("atlas.json", cache().atlases[key]);
+  mPrefetching = prefetching;
+}
+
+void AssetLoader::prepare(detail::AssetEntry &entry, const StringView &kind, const StringView &name) {
+  entry.key = String<>::formatted("{}/{}", mPath, name);
+  entry.kind = kind;
+  entry.lastUse = cache().generation;
+  entry.prefetched = mPrefetching;
+  mPending.push_back(&entry);
+}
+
+} // namespace sbs
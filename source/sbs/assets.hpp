@@ -0,0 +1,332 @@
+#pragma once
+
+/*
+assets.hpp
+----------
+Process-wide cache of decoded bundle entries
+*/
+
+#include "jobs.hpp"
+#include "perf.hpp"
+#include <concepts>
+#include <memory>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/data/bundle.hpp>
+#include <nwge/render/Font.hpp>
+#include <nwge/render/Texture.hpp>
+#include <SDL2/SDL_timer.h>
+#include <vector>
+
+namespace sbs {
+
+class Animation;
+
+namespace detail {
+
+/*
+Entries which split their load in three, so the expensive part overlaps the
+engine decoding everything else in the bundle:
+
+  read   - copies what it needs out of the file, on the loading thread
+  decode - parses it on a worker, see `JobGroup` for what it may not touch
+  finish - reports failures & commits the result, back on the main thread
+           before the state's `init`; returning false fails the load the
+           way `load` returning false would have
+*/
+template<typename T>
+concept SplitLoad = requires(T value, nwge::data::RW &file) {
+  { value.read(file) } -> std::same_as<bool>;
+  { value.decode() } -> std::same_as<void>;
+  { value.finish() } -> std::same_as<bool>;
+};
+
+struct AssetEntry {
+  /* `bundle/name`, unique per kind */
+  nwge::String<> key;
+  nwge::StringView kind;
+  s32 refs = 0;
+  /* bytes read from the bundle, or -1 when the engine decodes the entry */
+  s64 bytes = -1;
+  /* load generation in which the entry was last handed out */
+  u32 lastUse = 0;
+  /* time spent in `load`, or -1 when the engine decodes the entry */
+  s64 loadMicros = -1;
+  /* enqueued ahead of time & not yet handed out to the state it was for */
+  bool prefetched = false;
+  /* the loader which enqueued the entry has yet to finish it */
+  bool pending = true;
+  /* the load completed without error; entries which end up not pending & not
+     loaded are dropped once unreferenced, so the next load retries them */
+  bool loaded = false;
+
+  virtual ~AssetEntry() = default;
+
+  /* Completes a split load, see `SplitLoad`. */
+  virtual bool finish() {
+    return true;
+  }
+};
+
+inline s64 microsSince(u64 start) {
+  return s64((SDL_GetPerformanceCounter() - start) * 1000000
+    / SDL_GetPerformanceFrequency());
+}
+
+template<typename T>
+struct TypedAssetEntry: AssetEntry {
+  T value;
+  /* where a split load decodes, set by the loader which enqueued it */
+  JobGroup *jobs = nullptr;
+  bool decoding = false;
+  s64 decodeMicros = 0;
+
+  bool load(nwge::data::RW &file) {
+    SBS_PERF_SCOPE_NAMED(nwge::ScratchString::formatted("load {}", key));
+    bytes = file.size();
+    u64 start = SDL_GetPerformanceCounter();
+    bool ok;
+    if constexpr(SplitLoad<T>) {
+      ok = value.read(file);
+      if(ok) {
+        decoding = true;
+        jobs->submit([this]{
+          u64 decodeStart = SDL_GetPerformanceCounter();
+          value.decode();
+          decodeMicros = microsSince(decodeStart);
+        });
+      }
+    } else {
+      ok = value.load(file);
+    }
+    loadMicros = microsSince(start);
+    return ok;
+  }
+
+  bool finish() override {
+    if constexpr(SplitLoad<T>) {
+      if(!decoding) {
+        return true;
+      }
+      decoding = false;
+      loadMicros += decodeMicros;
+      return value.finish();
+    } else {
+      return true;
+    }
+  }
+};
+
+/* Returns the cached entry of the given kind, or null on a miss. */
+AssetEntry *findAsset(const nwge::StringView &kind, const nwge::StringView &key);
+/* Hands ownership of a freshly enqueued entry to the cache. */
+void insertAsset(std::unique_ptr<AssetEntry> &&entry);
+/* Marks an entry as used by the current load generation. */
+void touchAsset(AssetEntry &entry);
+/* Counts a prefetched entry as claimed by the state it was prefetched for. */
+void claimPrefetched(AssetEntry &entry);
+
+} // namespace detail
+
+/*
+A reference-counted handle to a cached asset. Unreferenced assets stay
+resident for a few state loads so going back and forth between states does
+not decode anything twice.
+*/
+template<typename T>
+class Asset {
+public:
+  Asset() = default;
+
+  Asset(const Asset &other)
+    : mEntry(other.mEntry)
+  {
+    retain();
+  }
+
+  Asset(Asset &&other) noexcept
+    : mEntry(other.mEntry)
+  {
+    other.mEntry = nullptr;
+  }
+
+  Asset &operator=(const Asset &other) {
+    if(this != &other) {
+      release();
+      mEntry = other.mEntry;
+      retain();
+    }
+    return *this;
+  }
+
+  Asset &operator=(Asset &&other) noexcept {
+    if(this != &other) {
+      release();
+      mEntry = other.mEntry;
+      other.mEntry = nullptr;
+    }
+    return *this;
+  }
+
+  ~Asset() {
+    release();
+  }
+
+  [[nodiscard]]
+  inline bool present() const {
+    return mEntry != nullptr;
+  }
+
+  inline T &operator*() {
+    return mEntry->value;
+  }
+
+  inline const T &operator*() const {
+    return mEntry->value;
+  }
+
+  inline T *operator->() {
+    return &mEntry->value;
+  }
+
+  inline const T *operator->() const {
+    return &mEntry->value;
+  }
+
+private:
+  friend class AssetLoader;
+
+  detail::TypedAssetEntry<T> *mEntry = nullptr;
+
+  void assign(detail::TypedAssetEntry<T> *entry) {
+    release();
+    mEntry = entry;
+    retain();
+  }
+
+  void retain() {
+    if(mEntry != nullptr) {
+      ++mEntry->refs;
+    }
+  }
+
+  void release() {
+    if(mEntry != nullptr) {
+      --mEntry->refs;
+      mEntry = nullptr;
+    }
+  }
+};
+
+/*
+A texture, or the region of an atlas page standing in for it. UVs passed to
+`mapPos`/`mapSize` are relative to the sprite, as if it was its own texture.
+*/
+struct Sprite {
+  Asset<nwge::render::Texture> texture;
+  glm::vec2 uvPos{0, 0};
+  glm::vec2 uvSize{1, 1};
+
+  [[nodiscard]]
+  inline glm::vec2 mapPos(glm::vec2 local = {0, 0}) const {
+    return uvPos + local * uvSize;
+  }
+
+  [[nodiscard]]
+  inline glm::vec2 mapSize(glm::vec2 local = {1, 1}) const {
+    return local * uvSize;
+  }
+};
+
+/*
+Per-state front-end to the cache. Mirrors the `data::Bundle` enqueue chain,
+but an entry that is already resident is handed out immediately and the
+bundle itself is only opened once something actually misses.
+*/
+class AssetLoader {
+public:
+  AssetLoader(const nwge::StringView &bundle = "sbs.bndl");
+  ~AssetLoader();
+
+  AssetLoader &nqTexture(const nwge::StringView &name, Asset<nwge::render::Texture> &out);
+  /* Resolves to the region of the atlas page once the bundle's atlas table
+     is resident, to the standalone file before that. */
+  AssetLoader &nqTexture(const nwge::StringView &name, Sprite &out);
+  AssetLoader &nqFont(const nwge::StringView &name, Asset<nwge::render::Font> &out);
+  /* Resolves to the sprite sheet pages packed from the GIF once the atlas
+     table is resident, to the GIF itself before that. */
+  AssetLoader &nqAnimation(const nwge::StringView &name, Animation &out);
+
+  template<typename T>
+  AssetLoader &nqCustom(const nwge::StringView &name, Asset<T> &out) {
+    if(lookup("custom", name, out)) {
+      return *this;
+    }
+    auto entry = std::make_unique<detail::TypedAssetEntry<T>>();
+    prepare(*entry, "custom", name);
+    if constexpr(detail::SplitLoad<T>) {
+      entry->jobs = &mJobs;
+      mSplit.push_back(entry.get());
+    }
+    bundle().nqCustom(name, *entry);
+    out.assign(entry.get());
+    detail::insertAsset(std::move(entry));
+    return *this;
+  }
+
+  /*
+  Prefetching: loads entries the likely next states will ask for along with
+  this state's own, without handing them out. They stay unreferenced in the
+  cache until the next state's loader claims them, so its load gap only
+  covers whatever it did not share.
+  */
+  AssetLoader &prefetchTexture(const nwge::StringView &name);
+  AssetLoader &prefetchFont(const nwge::StringView &name);
+  AssetLoader &prefetchAnimation(const nwge::StringView &name);
+
+  template<typename T>
+  AssetLoader &prefetchCustom(const nwge::StringView &name) {
+    Asset<T> discard;
+    mPrefetching = true;
+    nqCustom(name, discard);
+    mPrefetching = false;
+    return *this;
+  }
+
+  /* The underlying bundle, for entries which must not be shared. */
+  nwge::data::Bundle &bundle();
+
+  /* Waits for the split loads enqueued through this loader & completes them.
+     Call first thing in `init`, its result is the state's to return. */
+  bool finish();
+
+private:
+  nwge::StringView mPath;
+  nwge::data::Bundle mBundle;
+  bool mOpened = false;
+  bool mPrefetching = false;
+  JobGroup mJobs;
+  std::vector<detail::AssetEntry*> mSplit;
+  /* entries enqueued by this loader, until `finish` marks them loaded */
+  std::vector<detail::AssetEntry*> mPending;
+
+  template<typename T>
+  bool lookup(const nwge::StringView &kind, const nwge::StringView &name, Asset<T> &out) {
+    auto key = nwge::ScratchString::formatted("{}/{}", mPath, name);
+    auto *entry = detail::findAsset(kind, key);
+    if(entry == nullptr) {
+      return false;
+    }
+    detail::touchAsset(*entry);
+    if(entry->prefetched && !mPrefetching) {
+      detail::claimPrefetched(*entry);
+    }
+    out.assign(static_cast<detail::TypedAssetEntry<T>*>(entry));
+    return true;
+  }
+
+  void prepare(detail::AssetEntry &entry, const nwge::StringView &kind, const nwge::StringView &name);
+  void requestAtlas();
+};
+
+} // namespace sbs
@@ -1,92 +1,203 @@
 #include "config.hpp"
+#include "perf.hpp"
 #include <nwge/console.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/json.hpp>
 #include <SDL2/SDL_error.h>
+#include <SDL2/SDL_stdinc.h>
+#include <string>
+#include <vector>
 
 using namespace nwge;
 
 namespace sbs {
 
-static bool loadSocials(Config &out, const json::Object &root);
+namespace {
+
+/* Collects the strings of a JSON config so they can be copied into a single
+   allocation once the whole file has been walked. */
+class StringTable {
+public:
+  void add(StringView &target, const StringView &value) {
+    mFixups.push_back({&target, mBuffer.size(), value.size()});
+    mBuffer.append(value.begin(), value.size());
+  }
+
+  void finish(Array<char> &storage) {
+    storage = {mBuffer.size()};
+    if(mBuffer.empty()) {
+      // every string is empty & there is no storage to point into
+      for(const auto &fixup: mFixups) {
+        *fixup.target = {};
+      }
+      return;
+    }
+    SDL_memcpy(&storage[0], mBuffer.data(), mBuffer.size());
+    for(const auto &fixup: mFixups) {
+      *fixup.target = StringView{&storage[0] + fixup.offset, fixup.length};
+    }
+  }
+
+private:
+  struct Fixup {
+    StringView *target;
+    usize offset;
+    usize length;
+  };
+  std::string mBuffer;
+  std::vector<Fixup> mFixups;
+};
+
+/* where the load running on this thread reports its errors, see
+   `Config::ErrorSink` */
+thread_local Config::ErrorSink tErrors = Config::DialogErrors;
+
+/* Restores the previous sink once the load is done. */
+class ErrorScope {
+public:
+  ErrorScope(Config::ErrorSink errors)
+    : mPrevious(tErrors)
+  {
+    tErrors = errors;
+  }
+
+  ~ErrorScope() {
+    tErrors = mPrevious;
+  }
+
+  ErrorScope(const ErrorScope &other) = delete;
+  ErrorScope &operator=(const ErrorScope &other) = delete;
+
+private:
+  Config::ErrorSink mPrevious;
+};
+
+} // namespace
+
+/* Reports a load error to the current `tErrors` sink. A macro, so the format
+   string reaches either function as the literal it is. */
+#define SBS_CONFIG_ERROR(...) do { \
+    if(tErrors == Config::ConsoleErrors) { \
+      console::error(__VA_ARGS__); \
+    } else { \
+      dialog::error("Config", __VA_ARGS__); \
+    } \
+  } while(false)
+
+static bool parseStorage(Config &out);
+static bool loadBinary(Config &out);
+static bool loadJSON(Config &out);
+static bool parseJSON(Config &out, StringTable &strings);
+static bool loadSocials(Config &out, const json::Object &root, StringTable &strings);
 static bool loadLube(Config &out, const json::Object &root);
 static bool loadGravity(Config &out, const json::Object &root);
 static bool loadOxy(Config &out, const json::Object &root);
-static bool loadStore(Config &out, const json::Object &root);
+static bool loadStore(Config &out, const json::Object &root, StringTable &strings);
 static bool loadToilet(Config &out, const json::Object &root);
 static bool loadBrick(Config &out, const json::Object &root);
 static bool loadWater(Config &out, const json::Object &root);
 static bool loadShitter(Config &out, const json::Object &root);
 
+/*
+Layout of the compiled config, as written by source/bndl/plug.py. All values
+are little-endian.
+
+  header:  char[4] magic, u16 version, u16 store count, u32 string table
+           size, u32 total size
+  fixed:   lube, gravity, oxy, toilet, shitter, brick & water in declaration
+           order (tiers are s16 followed by 2 bytes of padding), then the
+           x.com & discord strings as u32 offset/length pairs
+  store:   s16 kind, s16 argument, s16 price, s16 icon, s32 prestige, then
+           name & desc as u32 offset/length pairs
+  strings: UTF-8, offsets are relative to the start of this table
+*/
+static constexpr char cBinaryMagic[4] = {'S', 'B', 'S', 'C'};
+static constexpr usize
+  cBinaryHeaderSize = 16,
+  cBinaryFixedSize = 152,
+  cBinaryItemSize = 28;
+
 bool Config::load(data::RW &file) {
   auto fileSize = file.size();
   if(fileSize <= 0) {
-    dialog::error("Config", "Configuration file is invalid or empty.");
+    SBS_CONFIG_ERROR("Configuration file is invalid or empty.");
     return false;
   }
 
-  ScratchArray<char> raw{usize(fileSize)};
-  if(!file.read(raw.view())) {
-    dialog::error("Config",
+  storage = {usize(fileSize)};
+  if(!file.read(storage.view())) {
+    SBS_CONFIG_ERROR(
       "Could not read the configuration file.\n"
       "{}",
       SDL_GetError());
     return false;
   }
+  return parseStorage(*this);
+}
 
-  auto res = json::parse(raw.view());
-  if(res.error != json::OK) {
-    dialog::error("Config",
-      "Configuration file is not valid JSON.\n"
-      "{}",
-      json::errorMessage(res.error));
+bool Config::loadMemory(const StringView &data, ErrorSink errors) {
+  ErrorScope scope{errors};
+  if(data.size() == 0) {
+    SBS_CONFIG_ERROR("Configuration file is invalid or empty.");
     return false;
   }
+  storage = {data.size()};
+  SDL_memcpy(&storage[0], data.begin(), data.size());
+  return parseStorage(*this);
+}
 
-  if(!res.value->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "Not an object.");
-    return false;
+bool parseStorage(Config &out) {
+  SBS_PERF_SCOPE("config parse");
+  if(out.storage.size() >= sizeof(cBinaryMagic)
+  && SDL_memcmp(&out.storage[0], cBinaryMagic, sizeof(cBinaryMagic)) == 0) {
+    return loadBinary(out);
   }
-  const auto &root = res.value->object();
 
-  if(!loadSocials(*this, root)) {
+  // not compiled by the bundle plugin, most likely a modded install
+  if(!loadJSON(out)) {
     return false;
   }
+  out.dump();
+  return true;
+}
 
-  if(!loadLube(*this, root)) {
-    return false;
+u32 Config::diff(const Config &other) const {
+  u32 changed = 0;
+  if(socials != other.socials) {
+    changed |= SocialsSection;
   }
-
-  if(!loadGravity(*this, root)) {
-    return false;
+  if(lube != other.lube) {
+    changed |= LubeSection;
   }
-
-  if(!loadOxy(*this, root)) {
-    return false;
+  if(gravity != other.gravity) {
+    changed |= GravitySection;
   }
-
-  if(!loadStore(*this, root)) {
-    return false;
+  if(oxy != other.oxy) {
+    changed |= OxySection;
   }
-
-  if(!loadToilet(*this, root)) {
-    return false;
+  if(toilet != other.toilet) {
+    changed |= ToiletSection;
   }
-
-  if(!loadBrick(*this, root)) {
-    return false;
+  if(shitter != other.shitter) {
+    changed |= ShitterSection;
   }
-
-  if(!loadWater(*this, root)) {
-    return false;
+  if(brick != other.brick) {
+    changed |= BrickSection;
   }
-
-  if(!loadShitter(*this, root)) {
-    return false;
+  if(water != other.water) {
+    changed |= WaterSection;
+  }
+  bool sameStore = store.size() == other.store.size();
+  for(usize i = 0; sameStore && i < store.size(); ++i) {
+    sameStore = store[i] == other.store[i];
+  }
+  if(!sameStore) {
+    changed |= StoreSection;
   }
+  return changed;
+}
 
+void Config::dump() const {
   console::note("Loaded config:");
   console::print("  Lube:");
   console::print("    Base: {}", lube.base);
@@ -113,20 +224,226 @@ bool Config::load(data::RW &file) {
   console::print("    Max Y: {}", water.maxY);
   console::print("    Width: {}", water.width);
   console::print("    Height: {}", water.height);
+}
+
+namespace {
+
+/* Sequential reader over a blob whose size has already been validated. */
+class BlobReader {
+public:
+  BlobReader(const char *data)
+    : mData(data)
+  {}
+
+  template<typename T>
+  T read() {
+    T value;
+    SDL_memcpy(&value, mData + mPos, sizeof(T));
+    mPos += sizeof(T);
+    return value;
+  }
+
+  s16 readTier() {
+    auto tier = read<s16>();
+    mPos += 2;
+    return tier;
+  }
+
+private:
+  const char *mData;
+  usize mPos = 0;
+};
+
+bool readBinaryString(
+  BlobReader &reader,
+  const char *strings, u32 stringsSize,
+  StringView &out
+) {
+  auto offset = reader.read<u32>();
+  auto length = reader.read<u32>();
+  if(offset > stringsSize || length > stringsSize - offset) {
+    return false;
+  }
+  out = StringView{strings + offset, length};
+  return true;
+}
+
+} // namespace
+
+bool loadBinary(Config &out) {
+  const usize size = out.storage.size();
+  const char *data = &out.storage[0];
+  if(size < cBinaryHeaderSize + cBinaryFixedSize) {
+    SBS_CONFIG_ERROR("Compiled configuration file is truncated.");
+    return false;
+  }
+
+  BlobReader reader{data + sizeof(cBinaryMagic)};
+  auto version = reader.read<u16>();
+  auto storeCount = reader.read<u16>();
+  auto stringsSize = reader.read<u32>();
+  auto totalSize = reader.read<u32>();
+  if(version != Config::cBinaryVersion) {
+    SBS_CONFIG_ERROR(
+      "Compiled configuration file has version {}, expected {}.\n"
+      "Rebuild the bundle.",
+      version, Config::cBinaryVersion);
+    return false;
+  }
+  const usize expectedSize = cBinaryHeaderSize + cBinaryFixedSize
+    + usize(storeCount) * cBinaryItemSize + stringsSize;
+  if(totalSize != size || expectedSize != size) {
+    SBS_CONFIG_ERROR("Compiled configuration file is truncated.");
+    return false;
+  }
+  const char *strings = data + size - stringsSize;
+
+  reader = BlobReader{data + cBinaryHeaderSize};
+  out.lube.base = reader.read<f32>();
+  out.lube.upgrade = reader.read<f32>();
+  out.lube.maxTier = reader.readTier();
+  out.gravity.base = reader.read<f32>();
+  out.gravity.upgrade = reader.read<f32>();
+  out.gravity.threshold = reader.read<f32>();
+  out.gravity.maxTier = reader.readTier();
+  out.oxy.regenFast = reader.read<f32>();
+  out.oxy.regenSlow = reader.read<f32>();
+  out.oxy.drain = reader.read<f32>();
+  out.oxy.min = reader.read<f32>();
+  out.oxy.cooldown = reader.read<f32>();
+  out.toilet.xPos = reader.read<f32>();
+  out.toilet.yPos = reader.read<f32>();
+  out.toilet.size = reader.read<f32>();
+  out.shitter.xPos = reader.read<f32>();
+  out.shitter.yPos = reader.read<f32>();
+  out.shitter.width = reader.read<f32>();
+  out.shitter.height = reader.read<f32>();
+  out.brick.xPos = reader.read<f32>();
+  out.brick.startY = reader.read<f32>();
+  out.brick.endY = reader.read<f32>();
+  out.brick.fallSpeed = reader.read<f32>();
+  out.brick.size = reader.read<f32>();
+  out.water.minX = reader.read<f32>();
+  out.water.maxX = reader.read<f32>();
+  out.water.minY = reader.read<f32>();
+  out.water.maxY = reader.read<f32>();
+  out.water.width = reader.read<f32>();
+  out.water.height = reader.read<f32>();
+  out.water.scissorX = reader.read<f32>();
+  out.water.scissorY = reader.read<f32>();
+  out.water.scissorW = reader.read<f32>();
+  out.water.scissorH = reader.read<f32>();
+  if(!readBinaryString(reader, strings, stringsSize, out.socials.xDotCom)
+  || !readBinaryString(reader, strings, stringsSize, out.socials.discord)) {
+    SBS_CONFIG_ERROR("Compiled configuration file has a bad string.");
+    return false;
+  }
+
+  out.store = {usize(storeCount)};
+  for(usize i = 0; i < out.store.size(); ++i) {
+    auto &item = out.store[i];
+    auto kind = reader.read<s16>();
+    if(kind <= StoreItem::None || kind > StoreItem::EndGame) {
+      SBS_CONFIG_ERROR(
+        "Compiled configuration file is invalid.\n"
+        "`store` element {} has unknown kind {}.",
+        i, kind);
+      return false;
+    }
+    item.kind = StoreItem::Kind(kind);
+    item.argument = reader.read<s16>();
+    item.price = reader.read<s16>();
+    item.icon = reader.read<s16>();
+    item.prestige = reader.read<s32>();
+    if(!readBinaryString(reader, strings, stringsSize, item.name)
+    || !readBinaryString(reader, strings, stringsSize, item.desc)) {
+      SBS_CONFIG_ERROR("Compiled configuration file has a bad string.");
+      return false;
+    }
+  }
+
+  console::note("Loaded compiled config v{} with {} store items.",
+    version, out.store.size());
+  return true;
+}
+
+bool loadJSON(Config &out) {
+  StringTable strings;
+  if(!parseJSON(out, strings)) {
+    return false;
+  }
+  // the raw text is no longer needed once the document has been walked
+  strings.finish(out.storage);
+  return true;
+}
+
+bool parseJSON(Config &out, StringTable &strings) {
+  auto res = json::parse(out.storage.view());
+  if(res.error != json::OK) {
+    SBS_CONFIG_ERROR(
+      "Configuration file is not valid JSON.\n"
+      "{}",
+      json::errorMessage(res.error));
+    return false;
+  }
+
+  if(!res.value->isObject()) {
+    SBS_CONFIG_ERROR(
+      "Configuration file is invalid.\n"
+      "Not an object.");
+    return false;
+  }
+  const auto &root = res.value->object();
+
+  if(!loadSocials(out, root, strings)) {
+    return false;
+  }
+
+  if(!loadLube(out, root)) {
+    return false;
+  }
+
+  if(!loadGravity(out, root)) {
+    return false;
+  }
+
+  if(!loadOxy(out, root)) {
+    return false;
+  }
+
+  if(!loadStore(out, root, strings)) {
+    return false;
+  }
+
+  if(!loadToilet(out, root)) {
+    return false;
+  }
+
+  if(!loadBrick(out, root)) {
+    return false;
+  }
+
+  if(!loadWater(out, root)) {
+    return false;
+  }
+
+  if(!loadShitter(out, root)) {
+    return false;
+  }
 
   return true;
 }
 
-bool loadSocials(Config &out, const json::Object &root) {
+bool loadSocials(Config &out, const json::Object &root, StringTable &strings) {
   const auto *socialsV = root.get("socials");
   if(socialsV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `socials` key.");
     return false;
   }
   if(!socialsV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`socials` is not a object.");
     return false;
@@ -135,46 +452,46 @@ bool loadSocials(Config &out, const json::Object &root) {
 
   const auto *xDotComV = socialsObject.get("x.com");
   if(xDotComV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `x.com` key in `socials` object.");
     return false;
   }
   if(!xDotComV->isString()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`x.com` is not a string.");
     return false;
   }
-  out.socials.xDotCom = xDotComV->string();
+  strings.add(out.socials.xDotCom, xDotComV->string());
 
   const auto *discordV = socialsObject.get("discord");
   if(discordV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `discord` key in `socials` object.");
     return false;
   }
   if(!discordV->isString()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`discord` is not a string.");
     return false;
   }
-  out.socials.discord = discordV->string();
+  strings.add(out.socials.discord, discordV->string());
   return true;
 }
 
 bool loadLube(Config &out, const json::Object &root) {
   const auto *lubeV = root.get("lube");
   if(lubeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `lube` key.");
     return false;
   }
   if(!lubeV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`lube` is not a object.");
     return false;
@@ -183,13 +500,13 @@ bool loadLube(Config &out, const json::Object &root) {
 
   const auto *baseV = lubeObject.get("base");
   if(baseV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `base` in key in `lube` object.");
     return false;
   }
   if(!baseV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`base` in `lube` object is not a number.");
     return false;
@@ -198,13 +515,13 @@ bool loadLube(Config &out, const json::Object &root) {
 
   const auto *upgradeV = lubeObject.get("upgrade");
   if(upgradeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `upgrade` in key in `lube` object.");
     return false;
   }
   if(!upgradeV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`upgrade` in `lube` object is not a number.");
     return false;
@@ -213,13 +530,13 @@ bool loadLube(Config &out, const json::Object &root) {
 
   const auto *maxTierV = lubeObject.get("maxTier");
   if(maxTierV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `maxTier` in key in `lube` object.");
     return false;
   }
   if(!maxTierV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`maxTier` in `lube` object is not a number.");
     return false;
@@ -232,13 +549,13 @@ bool loadLube(Config &out, const json::Object &root) {
 bool loadGravity(Config &out, const json::Object &root) {
   const auto *gravityV = root.get("gravity");
   if(gravityV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `gravity` key.");
     return false;
   }
   if(!gravityV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`gravity` is not a object.");
     return false;
@@ -247,13 +564,13 @@ bool loadGravity(Config &out, const json::Object &root) {
 
   const auto *baseV = gravityObject.get("base");
   if(baseV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `base` in key in `gravity` object.");
     return false;
   }
   if(!baseV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`base` in `gravity` object is not a number.");
     return false;
@@ -262,13 +579,13 @@ bool loadGravity(Config &out, const json::Object &root) {
 
   const auto *upgradeV = gravityObject.get("upgrade");
   if(upgradeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `upgrade` in key in `gravity` object.");
     return false;
   }
   if(!upgradeV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`upgrade` in `gravity` object is not a number.");
     return false;
@@ -277,13 +594,13 @@ bool loadGravity(Config &out, const json::Object &root) {
 
   const auto *thresholdV = gravityObject.get("threshold");
   if(thresholdV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `threshold` in key in `gravity` object.");
     return false;
   }
   if(!thresholdV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`threshold` in `gravity` object is not a number.");
     return false;
@@ -292,13 +609,13 @@ bool loadGravity(Config &out, const json::Object &root) {
 
   const auto *maxTierV = gravityObject.get("maxTier");
   if(maxTierV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `maxTier` in key in `gravity` object.");
     return false;
   }
   if(!maxTierV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`maxTier` in `gravity` object is not a number.");
     return false;
@@ -311,13 +628,13 @@ bool loadGravity(Config &out, const json::Object &root) {
 bool loadOxy(Config &out, const json::Object &root) {
   const auto *oxyV = root.get("oxy");
   if(oxyV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `oxy` key.");
     return false;
   }
   if(!oxyV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`oxy` is not a object.");
     return false;
@@ -326,13 +643,13 @@ bool loadOxy(Config &out, const json::Object &root) {
 
   const auto *regenFastV = oxyObject.get("regenFast");
   if(regenFastV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `regenFast` in key in `oxy` object.");
     return false;
   }
   if(!regenFastV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`regenFast` in `oxy` object is not a number.");
     return false;
@@ -341,13 +658,13 @@ bool loadOxy(Config &out, const json::Object &root) {
 
   const auto *regenSlowV = oxyObject.get("regenSlow");
   if(regenSlowV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `regenSlow` in key in `oxy` object.");
     return false;
   }
   if(!regenSlowV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`regenSlow` in `oxy` object is not a number.");
     return false;
@@ -356,13 +673,13 @@ bool loadOxy(Config &out, const json::Object &root) {
 
   const auto *drainV = oxyObject.get("drain");
   if(drainV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `drain` in key in `oxy` object.");
     return false;
   }
   if(!drainV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`drain` in `oxy` object is not a number.");
     return false;
@@ -371,13 +688,13 @@ bool loadOxy(Config &out, const json::Object &root) {
 
   const auto *minV = oxyObject.get("min");
   if(minV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `min` in key in `oxy` object.");
     return false;
   }
   if(!minV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`min` in `oxy` object is not a number.");
     return false;
@@ -386,13 +703,13 @@ bool loadOxy(Config &out, const json::Object &root) {
 
   const auto *cooldownV = oxyObject.get("cooldown");
   if(cooldownV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `cooldown` in key in `oxy` object.");
     return false;
   }
   if(!cooldownV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`cooldown` in `oxy` object is not a number.");
     return false;
@@ -402,16 +719,16 @@ bool loadOxy(Config &out, const json::Object &root) {
   return true;
 }
 
-bool loadStore(Config &out, const json::Object &root) {
+bool loadStore(Config &out, const json::Object &root, StringTable &strings) {
   const auto *storeV = root.get("store");
   if(storeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `store` key.");
     return false;
   }
   if(!storeV->isArray()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`store` is not an array.");
     return false;
@@ -423,7 +740,7 @@ bool loadStore(Config &out, const json::Object &root) {
     auto &item = out.store[i];
     const auto &itemV = storeArray[i];
     if(!itemV.isObject()) {
-      dialog::error("Config",
+      SBS_CONFIG_ERROR(
         "Configuration file is invalid.\n"
         "`store` element {} is not an object.",
         i);
@@ -433,27 +750,27 @@ bool loadStore(Config &out, const json::Object &root) {
 
     const auto *nameV = itemObject.get("name");
     if(nameV == nullptr || !nameV->isString()) {
-      dialog::error("Config",
+      SBS_CONFIG_ERROR(
         "Configuration file is invalid.\n"
         "`name` of `store` element {} is not a string.",
         i);
       return false;
     }
-    item.name = nameV->string();
+    strings.add(item.name, nameV->string());
 
     const auto *descV = itemObject.get("desc");
     if(descV == nullptr || !descV->isString()) {
-      dialog::error("Config",
+      SBS_CONFIG_ERROR(
         "Configuration file is invalid.\n"
         "`desc` of `store` element {} is not a string.",
         i);
       return false;
     }
-    item.desc = descV->string();
+    strings.add(item.desc, descV->string());
 
     const auto *priceV = itemObject.get("price");
     if(priceV == nullptr || !priceV->isNumber()) {
-      dialog::error("Config",
+      SBS_CONFIG_ERROR(
         "Configuration file is invalid.\n"
         "`price` of `store` element {} is not a Number.",
         i);
@@ -463,7 +780,7 @@ bool loadStore(Config &out, const json::Object &root) {
 
     const auto *iconV = itemObject.get("icon");
     if(iconV == nullptr || !iconV->isNumber()) {
-      dialog::error("Config",
+      SBS_CONFIG_ERROR(
         "Configuration file is invalid.\n"
         "`icon` of `store` element {} is not a Number.",
         i);
@@ -480,7 +797,7 @@ bool loadStore(Config &out, const json::Object &root) {
     if(lubeTierV != nullptr) {
       item.kind = StoreItem::Lube;
       if(!lubeTierV->isNumber()) {
-        dialog::error("Config",
+        SBS_CONFIG_ERROR(
           "Configuration file is invalid.\n"
           "`lubeTier` of `store` element {} is not a Number.",
           i);
@@ -493,7 +810,7 @@ bool loadStore(Config &out, const json::Object &root) {
     if(gravityTierV != nullptr) {
       item.kind = StoreItem::Gravity;
       if(!gravityTierV->isNumber()) {
-        dialog::error("Config",
+        SBS_CONFIG_ERROR(
           "Configuration file is invalid.\n"
           "`gravityTier` of `store` element {} is not a Number.",
           i);
@@ -506,7 +823,7 @@ bool loadStore(Config &out, const json::Object &root) {
     if(oxyTierV != nullptr) {
       item.kind = StoreItem::Oxy;
       if(!oxyTierV->isNumber()) {
-        dialog::error("Config",
+        SBS_CONFIG_ERROR(
           "Configuration file is invalid.\n"
           "`oxyTier` of `store` element {} is not a Number.",
           i);
@@ -520,7 +837,7 @@ bool loadStore(Config &out, const json::Object &root) {
       item.kind = StoreItem::EndGame;
       continue;
     }
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`store` element {} does not define `lubeTier`, `gravityTier` or `endGame`.",
       i);
@@ -532,13 +849,13 @@ bool loadStore(Config &out, const json::Object &root) {
 bool loadToilet(Config &out, const json::Object &root) {
   const auto *toiletV = root.get("toilet");
   if(toiletV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `toilet` key.");
     return false;
   }
   if(!toiletV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`toilet` is not a object.");
     return false;
@@ -547,13 +864,13 @@ bool loadToilet(Config &out, const json::Object &root) {
 
   const auto *xPosV = toiletObject.get("xPos");
   if(xPosV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `xPos` in key in `toilet` object.");
     return false;
   }
   if(!xPosV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`xPos` in `toilet` object is not a number.");
     return false;
@@ -562,13 +879,13 @@ bool loadToilet(Config &out, const json::Object &root) {
 
   const auto *yPosV = toiletObject.get("yPos");
   if(yPosV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `yPos` in key in `toilet` object.");
     return false;
   }
   if(!yPosV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`yPos` in `toilet` object is not a number.");
     return false;
@@ -577,13 +894,13 @@ bool loadToilet(Config &out, const json::Object &root) {
 
   const auto *sizeV = toiletObject.get("size");
   if(sizeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `size` in key in `toilet` object.");
     return false;
   }
   if(!sizeV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`size` in `toilet` object is not a number.");
     return false;
@@ -596,13 +913,13 @@ bool loadToilet(Config &out, const json::Object &root) {
 bool loadBrick(Config &out, const json::Object &root) {
   const auto *brickV = root.get("brick");
   if(brickV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `brick` key.");
     return false;
   }
   if(!brickV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`brick` is not a object.");
     return false;
@@ -611,13 +928,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 
   const auto *xPosV = brickObject.get("xPos");
   if(xPosV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `xPos` in key in `brick` object.");
     return false;
   }
   if(!xPosV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`xPos` in `brick` object is not a number.");
     return false;
@@ -626,13 +943,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 
   const auto *startYV = brickObject.get("startY");
   if(startYV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `startY` in key in `brick` object.");
     return false;
   }
   if(!startYV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`startY` in `brick` object is not a number.");
     return false;
@@ -641,13 +958,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 
   const auto *endYV = brickObject.get("endY");
   if(endYV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `endY` in key in `brick` object.");
     return false;
   }
   if(!endYV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`endY` in `brick` object is not a number.");
     return false;
@@ -656,13 +973,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 
   const auto *fallSpeedV = brickObject.get("fallSpeed");
   if(fallSpeedV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `fallSpeed` in key in `brick` object.");
     return false;
   }
   if(!fallSpeedV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`fallSpeed` in `brick` object is not a number.");
     return false;
@@ -671,13 +988,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 
   const auto *sizeV = brickObject.get("size");
   if(sizeV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `size` in key in `brick` object.");
     return false;
   }
   if(!sizeV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`size` in `brick` object is not a number.");
     return false;
@@ -690,13 +1007,13 @@ bool loadBrick(Config &out, const json::Object &root) {
 bool loadWater(Config &out, const json::Object &root) {
   const auto *waterV = root.get("water");
   if(waterV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `water` key.");
     return false;
   }
   if(!waterV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`water` is not a object.");
     return false;
@@ -705,13 +1022,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *minXV = waterObject.get("minX");
   if(minXV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `minX` in key in `water` object.");
     return false;
   }
   if(!minXV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`minX` in `water` object is not a number.");
     return false;
@@ -720,13 +1037,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *maxXV = waterObject.get("maxX");
   if(maxXV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `maxX` in key in `water` object.");
     return false;
   }
   if(!maxXV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`maxX` in `water` object is not a number.");
     return false;
@@ -735,13 +1052,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *minYV = waterObject.get("minY");
   if(minYV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `minY` in key in `water` object.");
     return false;
   }
   if(!minYV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`minY` in `water` object is not a number.");
     return false;
@@ -750,13 +1067,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *maxYV = waterObject.get("maxY");
   if(maxYV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `maxY` in key in `water` object.");
     return false;
   }
   if(!maxYV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`maxY` in `water` object is not a number.");
     return false;
@@ -765,13 +1082,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *widthV = waterObject.get("width");
   if(widthV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `width` in key in `water` object.");
     return false;
   }
   if(!widthV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`width` in `water` object is not a number.");
     return false;
@@ -780,13 +1097,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *heightV = waterObject.get("height");
   if(heightV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `height` in key in `water` object.");
     return false;
   }
   if(!heightV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`height` in `water` object is not a number.");
     return false;
@@ -795,13 +1112,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *scissorXV = waterObject.get("scissorX");
   if(scissorXV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `scissorX` in key in `water` object.");
     return false;
   }
   if(!scissorXV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`scissorX` in `water` object is not a number.");
     return false;
@@ -810,13 +1127,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *scissorYV = waterObject.get("scissorY");
   if(scissorYV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `scissorY` in key in `water` object.");
     return false;
   }
   if(!scissorYV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`scissorY` in `water` object is not a number.");
     return false;
@@ -825,13 +1142,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *scissorWV = waterObject.get("scissorW");
   if(scissorWV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `scissorW` in key in `water` object.");
     return false;
   }
   if(!scissorWV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`scissorW` in `water` object is not a number.");
     return false;
@@ -840,13 +1157,13 @@ bool loadWater(Config &out, const json::Object &root) {
 
   const auto *scissorHV = waterObject.get("scissorH");
   if(scissorHV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `scissorH` in key in `water` object.");
     return false;
   }
   if(!scissorHV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`scissorH` in `water` object is not a number.");
     return false;
@@ -859,13 +1176,13 @@ bool loadWater(Config &out, const json::Object &root) {
 bool loadShitter(Config &out, const json::Object &root) {
   const auto *shitterV = root.get("shitter");
   if(shitterV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `shitter` key.");
     return false;
   }
   if(!shitterV->isObject()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`shitter` is not a object.");
     return false;
@@ -874,13 +1191,13 @@ bool loadShitter(Config &out, const json::Object &root) {
 
   const auto *xPosV = shitterObject.get("xPos");
   if(xPosV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `xPos` in key in `shitter` object.");
     return false;
   }
   if(!xPosV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`xPos` in `shitter` object is not a number.");
     return false;
@@ -889,13 +1206,13 @@ bool loadShitter(Config &out, const json::Object &root) {
 
   const auto *yPosV = shitterObject.get("yPos");
   if(yPosV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `yPos` in key in `shitter` object.");
     return false;
   }
   if(!yPosV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`yPos` in `shitter` object is not a number.");
     return false;
@@ -904,13 +1221,13 @@ bool loadShitter(Config &out, const json::Object &root) {
 
   const auto *widthV = shitterObject.get("width");
   if(widthV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `width` in key in `shitter` object.");
     return false;
   }
   if(!widthV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`width` in `shitter` object is not a number.");
     return false;
@@ -919,13 +1236,13 @@ bool loadShitter(Config &out, const json::Object &root) {
 
   const auto *heightV = shitterObject.get("height");
   if(heightV == nullptr) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "No `height` in key in `shitter` object.");
     return false;
   }
   if(!heightV->isNumber()) {
-    dialog::error("Config",
+    SBS_CONFIG_ERROR(
       "Configuration file is invalid.\n"
       "`height` in `shitter` object is not a number.");
     return false;
@@ -26,25 +26,36 @@ struct StoreItem {
   s16 price = 1;
   s16 icon = 0;
   s32 prestige = 0; // minimum prestige level for item to be available
-  nwge::String<> name;
-  nwge::String<> desc;
+  nwge::StringView name;
+  nwge::StringView desc;
+
+  bool operator==(const StoreItem &other) const = default;
 };
 
 struct Config {
+  /* version of the compiled config written by the bundle plugin */
+  static constexpr u16 cBinaryVersion = 1;
+
   struct Socials {
-    nwge::String<> xDotCom;
-    nwge::String<> discord;
+    nwge::StringView xDotCom;
+    nwge::StringView discord;
+
+    bool operator==(const Socials &other) const = default;
   } socials;
   struct Lube {
     f32 base;
     f32 upgrade;
     s16 maxTier;
+
+    bool operator==(const Lube &other) const = default;
   } lube;
   struct Gravity {
     f32 base;
     f32 upgrade;
     f32 threshold;
     s16 maxTier;
+
+    bool operator==(const Gravity &other) const = default;
   } gravity;
   struct Oxy {
     f32 regenFast;
@@ -52,17 +63,23 @@ struct Config {
     f32 drain;
     f32 min;
     f32 cooldown;
+
+    bool operator==(const Oxy &other) const = default;
   } oxy;
   struct Toilet {
     f32 xPos;
     f32 yPos;
     f32 size;
+
+    bool operator==(const Toilet &other) const = default;
   } toilet;
   struct Shitter {
     f32 xPos;
     f32 yPos;
     f32 width;
     f32 height;
+
+    bool operator==(const Shitter &other) const = default;
   } shitter;
   struct Brick {
     f32 xPos;
@@ -70,6 +87,8 @@ struct Config {
     f32 endY;
     f32 fallSpeed;
     f32 size;
+
+    bool operator==(const Brick &other) const = default;
   } brick;
   struct Water {
     f32 minX;
@@ -82,10 +101,48 @@ struct Config {
     f32 scissorY;
     f32 scissorW;
     f32 scissorH;
+
+    bool operator==(const Water &other) const = default;
   } water;
   nwge::Array<StoreItem> store;
 
+  /* backing storage of every string view above: either the compiled config
+     itself or the strings copied out of the JSON */
+  nwge::Array<char> storage;
+
+  /* bumped whenever a reload changes `store`, so whoever keeps per-item
+     state knows to rebuild it */
+  u32 storeRevision = 0;
+
+  enum Section: u32 {
+    SocialsSection = 1 << 0,
+    LubeSection    = 1 << 1,
+    GravitySection = 1 << 2,
+    OxySection     = 1 << 3,
+    ToiletSection  = 1 << 4,
+    ShitterSection = 1 << 5,
+    BrickSection   = 1 << 6,
+    WaterSection   = 1 << 7,
+    StoreSection   = 1 << 8,
+  };
+
+  /* The sections which differ from `other`, as a mask of `Section`s. */
+  [[nodiscard]]
+  u32 diff(const Config &other) const;
+
+  /* where load errors go: a dialog suits startup, but blocks the game when
+     the config is reloaded while it runs */
+  enum ErrorSink {
+    DialogErrors,
+    ConsoleErrors,
+  };
+
+  /* Loads either the compiled config or, for modded bundles, plain JSON. */
   bool load(nwge::data::RW &file);
+  /* Same as `load`, for tools reading the file without the engine & for
+     reloads, which pass `ConsoleErrors`. */
+  bool loadMemory(const nwge::StringView &data, ErrorSink errors = DialogErrors);
+  void dump() const;
 };
 
 } // namespace sbs
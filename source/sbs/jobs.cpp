@@ -0,0 +1,85 @@
+#include "jobs.hpp"
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sbs {
+
+class JobPool {
+public:
+  JobPool() {
+    // one core is left to the main thread, which keeps feeding the engine
+    // bundle entries while the workers decode
+    usize count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for(usize i = 0; i < count; ++i) {
+      std::thread{[this]{ work(); }}.detach();
+    }
+  }
+
+  void submit(JobGroup &group, std::function<void()> &&job) {
+    {
+      std::lock_guard lock{group.mMutex};
+      ++group.mPending;
+    }
+    {
+      std::lock_guard lock{mMutex};
+      mQueue.push_back({&group, std::move(job)});
+    }
+    mWake.notify_one();
+  }
+
+private:
+  struct Job {
+    JobGroup *group;
+    std::function<void()> run;
+  };
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::deque<Job> mQueue;
+
+  [[noreturn]]
+  void work() {
+    for(;;) {
+      Job job;
+      {
+        std::unique_lock lock{mMutex};
+        mWake.wait(lock, [this]{ return !mQueue.empty(); });
+        job = std::move(mQueue.front());
+        mQueue.pop_front();
+      }
+      job.run();
+      job.group->finished();
+    }
+  }
+};
+
+namespace {
+
+/* Deliberately leaked, the workers are never joined. */
+JobPool &pool() {
+  static auto *sPool = new JobPool;
+  return *sPool;
+}
+
+} // namespace
+
+void JobGroup::submit(std::function<void()> &&job) {
+  pool().submit(*this, std::move(job));
+}
+
+void JobGroup::wait() {
+  std::unique_lock lock{mMutex};
+  mDone.wait(lock, [this]{ return mPending == 0; });
+}
+
+void JobGroup::finished() {
+  std::lock_guard lock{mMutex};
+  if(--mPending == 0) {
+    mDone.notify_all();
+  }
+}
+
+} // namespace sbs
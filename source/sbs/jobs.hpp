@@ -0,0 +1,46 @@
+#pragma once
+
+/*
+jobs.hpp
+--------
+Process-wide worker pool for load-time work
+*/
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/*
+A batch of jobs on the shared worker pool which is waited for as a whole.
+Jobs must not touch the GL context, the console or dialogs: whatever has to
+happen on the main thread is left for after `wait`.
+*/
+class JobGroup {
+public:
+  JobGroup() = default;
+  JobGroup(const JobGroup &other) = delete;
+  JobGroup &operator=(const JobGroup &other) = delete;
+
+  ~JobGroup() {
+    wait();
+  }
+
+  void submit(std::function<void()> &&job);
+
+  /* Blocks until every job submitted so far has run. */
+  void wait();
+
+private:
+  friend class JobPool;
+
+  std::mutex mMutex;
+  std::condition_variable mDone;
+  usize mPending = 0;
+
+  void finished();
+};
+
+} // namespace sbs
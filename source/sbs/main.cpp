@@ -1,19 +1,71 @@
 #include <nwge/engine.hpp>
 #include <nwge/cli/cli.h>
+#include "FramePacer.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
 #include "states.hpp"
+#include <SDL2/SDL_stdinc.h>
+#include <string>
+
+/* `--game-fps`, `--menu-fps` & `--idle-fps <fps>` override the caps. They are
+   not part of the startup config handed to `startPtr` below: that is nwge's
+   own `config::Dev`, which has no room for the game's settings. */
+static void fpsParameter(const nwge::StringView &name, f32 &out) {
+  auto value = nwge::cli::parameter(name);
+  if(value.present()) {
+    std::string text{value->begin(), value->size()};
+    out = SDL_max(std::strtof(text.c_str(), nullptr), 0.0f);
+  }
+}
 
 s32 main(s32 argc, CStr *argv) {
+  SBS_PERF_MILESTONE("process start");
   nwge::cli::parse(argc, argv);
 
-  nwge::State *statePtr;
+  sbs::FramePacer::Limits limits;
+  fpsParameter("game-fps"_sv, limits.gameFps);
+  fpsParameter("menu-fps"_sv, limits.menuFps);
+  fpsParameter("idle-fps"_sv, limits.idleFps);
+  sbs::framePacer().configure(limits);
+
+  auto start = sbs::Recorder::StartWarning;
   if(nwge::cli::flag("game")) {
-    statePtr = sbs::getShitState({});
+    start = sbs::Recorder::StartGame;
   } else if(nwge::cli::flag("menu")) {
-    statePtr = sbs::getMenuState({});
+    start = sbs::Recorder::StartMenu;
   } else if(nwge::cli::flag("end")) {
+    start = sbs::Recorder::StartEnd;
+  }
+
+  // `--replay <file>` starts wherever the recording did
+  auto replayPath = nwge::cli::parameter("replay"_sv);
+  auto recordPath = nwge::cli::parameter("record"_sv);
+  if(replayPath.present()) {
+    std::string path{replayPath->begin(), replayPath->size()};
+    if(!sbs::recorder().replay(path.c_str(), start)) {
+      return 1;
+    }
+  } else if(recordPath.present()) {
+    std::string path{recordPath->begin(), recordPath->size()};
+    if(!sbs::recorder().record(path.c_str(), start)) {
+      return 1;
+    }
+  }
+
+  nwge::State *statePtr;
+  switch(start) {
+  case sbs::Recorder::StartGame:
+    statePtr = sbs::getShitState({});
+    break;
+  case sbs::Recorder::StartMenu:
+    statePtr = sbs::getMenuState({});
+    break;
+  case sbs::Recorder::StartEnd:
     statePtr = sbs::getEndState();
-  } else {
+    break;
+  default:
     statePtr = sbs::getWarningState();
+    break;
   }
 
   nwge::startPtr(statePtr, {
@@ -22,5 +74,6 @@ s32 main(s32 argc, CStr *argv) {
     .windowAspectRatio = {1, 1},
     .filterFonts = false,
   });
+  sbs::recorder().finish();
   return 0;
 }
@@ -6,20 +6,17 @@ minigames.hpp
 Mini-game-related definitions
 */
 
+#include "assets.hpp"
 #include <nwge/state.hpp>
 #include <nwge/render/Font.hpp>
+#include <nwge/render/Texture.hpp>
 
 namespace sbs {
 
 class MiniGame {
 public:
-  enum Return {
-    ReturnToMenu,
-    ReturnToGame,
-  };
-
   struct Data {
-    nwge::render::Font font;
+    Asset<nwge::render::Font> font;
     static constexpr s32 cFakeResolution = 240;
     static constexpr f32 cZ = 0.5f;
 
@@ -27,12 +24,12 @@ public:
       f32 trueX = f32(x) / cFakeResolution;
       f32 trueY = f32(y) / cFakeResolution;
       f32 trueH = f32(h) / cFakeResolution;
-      font.draw(text, {trueX, trueY, cZ}, trueH);
+      font->draw(text, {trueX, trueY, cZ}, trueH);
     }
   };
 
 protected:
-  friend class MiniGameState;
+  friend class MiniGameSubState;
 
   enum Input {
     NoInput,
@@ -51,12 +48,41 @@ protected:
 public:
   virtual ~MiniGame() = default;
   virtual void init(Data &data) = 0;
-  virtual bool on(Input input) = 0;
+
+  virtual bool on(Input input) {
+    return true;
+  }
+
+  /* The same input along with when it happened, in seconds on the
+     mini-game's clock: the sum of every `delta` passed to `tick` so far.
+     A frame's inputs arrive in order before its `tick`, with times inside
+     that frame. The time is only as precise as the moment nwge dispatches
+     the key bind, which is at the frame boundary, so most inputs land
+     close to the end of their frame rather than where the key went down.
+     Replayed inputs are pushed at the start of the tick and always land at
+     the very end, so the times of a replay do not match the recording.
+     Forwards to the untimed overload unless overridden. */
+  virtual bool on(Input input, f64 time) {
+    return on(input);
+  }
+
   virtual bool tick(f32 delta) = 0;
   virtual void render() = 0;
   static MiniGame *test(); // simple testing mini-game
 };
 
-nwge::State *getMiniGameState(MiniGame *game, MiniGame::Return returnTo);
+/* What a mini-game needs from the bundle. A state which can start one
+   enqueues these with its own assets, so no load stands between it and the
+   mini-game in either direction. */
+struct MiniGameAssets {
+  Asset<nwge::render::Font> font;
+  Asset<nwge::render::Texture> scanlines;
+
+  void nq(AssetLoader &assets);
+};
+
+/* Runs the mini-game on top of the current state, which is paused, keeping
+   its assets, and resumes where it left off once the mini-game ends. */
+nwge::SubState *getMiniGameSubState(MiniGame *game, const MiniGameAssets &assets);
 
 } // namespace sbs
@@ -0,0 +1,382 @@
+#include "perf.hpp"
+#include "version.h"
+
+#if SBS_PERF
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <nwge/console.hpp>
+#include <nwge/console/Command.hpp>
+#include <SDL2/SDL_rwops.h>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace nwge;
+
+namespace sbs::perf {
+
+namespace {
+
+/* taken during static initialization, as close to process start as the
+   game gets */
+const u64 sProcessStart = SDL_GetPerformanceCounter();
+
+struct Event {
+  u32 id;
+  u32 thread;
+  u64 start;
+  u64 end;
+};
+
+/*
+Single-producer ring: only the owning thread writes, and it publishes each
+event by bumping `head` afterwards. The collector copies out everything
+between its `tail` and `head`. An event the producer may have lapped while
+it was being copied is thrown away rather than reported torn.
+*/
+struct Ring {
+  static constexpr u64 cCapacity = 1 << 14;
+
+  std::array<Event, cCapacity> events;
+  std::atomic<u64> head{0};
+  u64 tail = 0;
+  u32 thread;
+};
+
+/*
+Log-linear histogram of durations in nanoseconds: exact below 16, then 8
+buckets per power of two, so every percentile is within 12.5%.
+*/
+struct Histogram {
+  static constexpr usize cLinear = 16;
+  static constexpr usize cSubBuckets = 8;
+  static constexpr usize cBuckets = cLinear + (64 - 4) * cSubBuckets;
+
+  std::array<u32, cBuckets> buckets{};
+  u64 count = 0;
+  u64 total = 0;
+  u64 max = 0;
+
+  static usize bucket(u64 nanos) {
+    if(nanos < cLinear) {
+      return usize(nanos);
+    }
+    usize exp = 63 - usize(__builtin_clzll(nanos));
+    usize sub = usize(nanos >> (exp - 3)) & (cSubBuckets - 1);
+    return cLinear + (exp - 4) * cSubBuckets + sub;
+  }
+
+  static u64 lowerBound(usize index) {
+    if(index < cLinear) {
+      return index;
+    }
+    usize exp = (index - cLinear) / cSubBuckets + 4;
+    usize sub = (index - cLinear) % cSubBuckets;
+    return (u64(cSubBuckets + sub)) << (exp - 3);
+  }
+
+  void add(u64 nanos) {
+    ++buckets[bucket(nanos)];
+    ++count;
+    total += nanos;
+    max = std::max(max, nanos);
+  }
+
+  [[nodiscard]]
+  u64 percentile(u32 pct) const {
+    u64 rank = (count * pct + 99) / 100;
+    u64 seen = 0;
+    for(usize i = 0; i < cBuckets; ++i) {
+      seen += buckets[i];
+      if(seen >= rank && seen != 0) {
+        return std::min(lowerBound(i), max);
+      }
+    }
+    return max;
+  }
+};
+
+class Registry {
+public:
+  /* most recent events kept around for `sbs.perf trace` */
+  static constexpr usize cTraceCapacity = 1 << 16;
+
+  u32 intern(const StringView &name) {
+    std::lock_guard lock{mNamesMutex};
+    std::string key{name.begin(), name.size()};
+    auto iter = mIds.find(key);
+    if(iter != mIds.end()) {
+      return iter->second;
+    }
+    auto id = u32(mNames.size());
+    mNames.push_back(key);
+    mIds.emplace(std::move(key), id);
+    return id;
+  }
+
+  Ring &ring() {
+    thread_local Ring *tRing = nullptr;
+    if(tRing == nullptr) {
+      // rings outlive their threads, the collector may still be reading
+      auto ring = std::make_unique<Ring>();
+      tRing = ring.get();
+      std::lock_guard lock{mRingsMutex};
+      ring->thread = u32(mRings.size());
+      mRings.push_back(std::move(ring));
+    }
+    return *tRing;
+  }
+
+  /* Called by producers every half ring. Skips if someone else is already
+     collecting, instead of waiting. */
+  void tryCollect() {
+    std::unique_lock lock{mCollectMutex, std::try_to_lock};
+    if(lock.owns_lock()) {
+      collectLocked();
+    }
+  }
+
+  void report() {
+    std::lock_guard lock{mCollectMutex};
+    collectLocked();
+    std::vector<u32> order;
+    for(u32 id = 0; id < mStats.size(); ++id) {
+      if(mStats[id].count != 0) {
+        order.push_back(id);
+      }
+    }
+    std::sort(order.begin(), order.end(), [this](u32 lhs, u32 rhs){
+      return mStats[lhs].total > mStats[rhs].total;
+    });
+    if(!mMilestones.empty()) {
+      console::note("{} startup milestones (ms since process start):", SBS_VER_STR);
+      for(const auto &milestone: mMilestones) {
+        console::print("  {}: {}", milestone.name, millis(milestone.at));
+      }
+    }
+    console::note("{} timers, {} events dropped (times in us):", order.size(), mDropped);
+    for(u32 id: order) {
+      const auto &stat = mStats[id];
+      auto timer = name(id);
+      console::print("  {}: {} calls, p50 {}, p95 {}, p99 {}, max {}, total {}",
+        StringView{timer.data(), timer.size()}, stat.count,
+        stat.percentile(50) / 1000, stat.percentile(95) / 1000,
+        stat.percentile(99) / 1000, stat.max / 1000, stat.total / 1000);
+    }
+  }
+
+  void milestone(const char *name) {
+    u64 now = SDL_GetPerformanceCounter();
+    std::lock_guard lock{mCollectMutex};
+    for(const auto &milestone: mMilestones) {
+      if(std::strcmp(milestone.name, name) == 0) {
+        return;
+      }
+    }
+    mMilestones.push_back({name, now});
+    console::note("{} after {} ms ({})", name, millis(now), SBS_VER_STR);
+  }
+
+  /* Milestones are kept, they only happen once per process. */
+  void reset() {
+    std::lock_guard lock{mCollectMutex};
+    collectLocked();
+    mStats.clear();
+    mTrace.clear();
+    mTraceNext = 0;
+    mDropped = 0;
+  }
+
+  /* Writes the kept events in the Chrome trace event format, loadable in
+     chrome://tracing or Perfetto. */
+  void trace(const std::string &path) {
+    std::lock_guard lock{mCollectMutex};
+    collectLocked();
+    std::vector<Event> events;
+    events.reserve(mTrace.size());
+    events.insert(events.end(), mTrace.begin() + mTraceNext, mTrace.end());
+    events.insert(events.end(), mTrace.begin(), mTrace.begin() + mTraceNext);
+
+    auto *file = SDL_RWFromFile(path.c_str(), "wb");
+    if(file == nullptr) {
+      console::error("Could not open {}: {}", StringView{path.data(), path.size()},
+        SDL_GetError());
+      return;
+    }
+    f64 toMicros = 1e6 / f64(SDL_GetPerformanceFrequency());
+    std::string out = "{\"traceEvents\":[";
+    for(usize i = 0; i < events.size(); ++i) {
+      const auto &event = events[i];
+      if(i != 0) {
+        out += ',';
+      }
+      out += "{\"name\":\"";
+      for(char ch: name(event.id)) {
+        if(ch == '"' || ch == '\\') {
+          out += '\\';
+        }
+        out += ch;
+      }
+      out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+      out += std::to_string(event.thread);
+      out += ",\"ts\":";
+      out += std::to_string(f64(event.start - mEpoch) * toMicros);
+      out += ",\"dur\":";
+      out += std::to_string(f64(event.end - event.start) * toMicros);
+      out += '}';
+    }
+    // milestones as global instant events, they show up as lines across
+    // every thread
+    for(const auto &milestone: mMilestones) {
+      if(out.back() != '[') {
+        out += ',';
+      }
+      out += "{\"name\":\"";
+      out += milestone.name;
+      out += "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":";
+      out += std::to_string(f64(milestone.at - mEpoch) * toMicros);
+      out += '}';
+    }
+    out += "]}";
+    bool ok = SDL_RWwrite(file, out.data(), 1, out.size()) == out.size();
+    SDL_RWclose(file);
+    if(!ok) {
+      console::error("Could not write {}: {}", StringView{path.data(), path.size()},
+        SDL_GetError());
+      return;
+    }
+    console::print("wrote {} events to {}", events.size(),
+      StringView{path.data(), path.size()});
+  }
+
+private:
+  std::mutex mNamesMutex;
+  std::unordered_map<std::string, u32> mIds;
+  std::vector<std::string> mNames;
+
+  std::mutex mRingsMutex;
+  std::vector<std::unique_ptr<Ring>> mRings;
+
+  std::mutex mCollectMutex;
+  std::vector<Histogram> mStats;
+  std::vector<Event> mTrace;
+  usize mTraceNext = 0;
+  u64 mDropped = 0;
+  u64 mEpoch = sProcessStart;
+
+  struct Milestone {
+    const char *name;
+    u64 at;
+  };
+  std::vector<Milestone> mMilestones;
+
+  console::Command mCommand{"sbs.perf", [this](auto &args){
+    if(args.size() >= 1 && args[0] == "reset"_sv) {
+      reset();
+      console::print("perf counters reset");
+      return;
+    }
+    if(args.size() >= 1 && args[0] == "trace"_sv) {
+      std::string path = "sbs-trace.json";
+      if(args.size() >= 2) {
+        path.assign(args[1].begin(), args[1].size());
+      }
+      trace(path);
+      return;
+    }
+    report();
+  }};
+
+  static f64 millis(u64 counter) {
+    return f64(counter - sProcessStart) * 1e3 / f64(SDL_GetPerformanceFrequency());
+  }
+
+  std::string name(u32 id) {
+    std::lock_guard lock{mNamesMutex};
+    return mNames[id];
+  }
+
+  void collectLocked() {
+    std::vector<Ring*> rings;
+    {
+      std::lock_guard lock{mRingsMutex};
+      for(const auto &ring: mRings) {
+        rings.push_back(ring.get());
+      }
+    }
+    f64 toNanos = 1e9 / f64(SDL_GetPerformanceFrequency());
+    for(auto *ring: rings) {
+      u64 head = ring->head.load(std::memory_order_acquire);
+      if(head - ring->tail > Ring::cCapacity) {
+        mDropped += head - ring->tail - Ring::cCapacity;
+        ring->tail = head - Ring::cCapacity;
+      }
+      std::vector<Event> copied;
+      copied.reserve(head - ring->tail);
+      for(u64 i = ring->tail; i < head; ++i) {
+        copied.push_back(ring->events[i % Ring::cCapacity]);
+      }
+      // anything the producer got around to overwriting meanwhile is suspect
+      u64 after = ring->head.load(std::memory_order_acquire);
+      u64 firstValid = after > Ring::cCapacity ? after - Ring::cCapacity : 0;
+      for(u64 i = ring->tail; i < head; ++i) {
+        if(i < firstValid) {
+          ++mDropped;
+          continue;
+        }
+        add(copied[i - ring->tail], toNanos);
+      }
+      ring->tail = head;
+    }
+  }
+
+  void add(const Event &event, f64 toNanos) {
+    if(event.id >= mStats.size()) {
+      mStats.resize(event.id + 1);
+    }
+    mStats[event.id].add(u64(f64(event.end - event.start) * toNanos));
+    if(mTrace.size() < cTraceCapacity) {
+      mTrace.push_back(event);
+    } else {
+      mTrace[mTraceNext] = event;
+      mTraceNext = (mTraceNext + 1) % cTraceCapacity;
+    }
+  }
+};
+
+/* Deliberately leaked, like the asset cache: timers may still fire from
+   static destructors. */
+Registry &registry() {
+  static auto *sRegistry = new Registry;
+  return *sRegistry;
+}
+
+} // namespace
+
+u32 intern(const StringView &name) {
+  return registry().intern(name);
+}
+
+void milestone(const char *name) {
+  registry().milestone(name);
+}
+
+void record(u32 id, u64 start, u64 end) {
+  auto &reg = registry();
+  auto &ring = reg.ring();
+  u64 head = ring.head.load(std::memory_order_relaxed);
+  ring.events[head % Ring::cCapacity] = {id, ring.thread, start, end};
+  ring.head.store(head + 1, std::memory_order_release);
+  if((head + 1) % (Ring::cCapacity / 2) == 0) {
+    reg.tryCollect();
+  }
+}
+
+} // namespace sbs::perf
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+perf.hpp
+--------
+Scoped timers, reported by the `sbs.perf` console command
+*/
+
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <SDL2/SDL_timer.h>
+
+/* Set to 0 to compile every timer out. The macros below then expand to
+   nothing, their arguments included, so production builds pay nothing. */
+#ifndef SBS_PERF
+#define SBS_PERF 1
+#endif
+
+#if SBS_PERF
+
+namespace sbs::perf {
+
+/* Returns the id of a timer name, the same one for every call with the same
+   text. Takes a lock, so hot paths intern once through `SBS_PERF_SCOPE`. */
+u32 intern(const nwge::StringView &name);
+
+/* Appends a sample to the calling thread's ring buffer. Never blocks. */
+void record(u32 id, u64 start, u64 end);
+
+/* Logs how long after process start `name` was first reached; later calls
+   with the same name are ignored. `sbs.perf` lists them again. */
+void milestone(const char *name);
+
+class Scope {
+public:
+  explicit Scope(u32 id)
+    : mId(id), mStart(SDL_GetPerformanceCounter())
+  {}
+
+  Scope(const Scope &other) = delete;
+  Scope &operator=(const Scope &other) = delete;
+
+  ~Scope() {
+    record(mId, mStart, SDL_GetPerformanceCounter());
+  }
+
+private:
+  u32 mId;
+  u64 mStart;
+};
+
+} // namespace sbs::perf
+
+#define SBS_PERF_CONCAT_(a, b) a##b
+#define SBS_PERF_CONCAT(a, b) SBS_PERF_CONCAT_(a, b)
+
+/* Times the rest of the enclosing block under a fixed name. */
+#define SBS_PERF_SCOPE(name) \
+  static const u32 SBS_PERF_CONCAT(sbsPerfId, __LINE__) = ::sbs::perf::intern(name); \
+  ::sbs::perf::Scope SBS_PERF_CONCAT(sbsPerfScope, __LINE__){SBS_PERF_CONCAT(sbsPerfId, __LINE__)}
+
+/* Times the rest of the enclosing block under a name only known at runtime,
+   for things which happen a handful of times, like bundle loads. */
+#define SBS_PERF_SCOPE_NAMED(name) \
+  ::sbs::perf::Scope SBS_PERF_CONCAT(sbsPerfScope, __LINE__){::sbs::perf::intern(name)}
+
+/* Marks a startup milestone, see `perf::milestone`. */
+#define SBS_PERF_MILESTONE(name) ::sbs::perf::milestone(name)
+
+#else
+
+#define SBS_PERF_SCOPE(name) static_cast<void>(0)
+#define SBS_PERF_SCOPE_NAMED(name) static_cast<void>(0)
+#define SBS_PERF_MILESTONE(name) static_cast<void>(0)
+
+#endif
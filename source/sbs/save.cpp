@@ -1,8 +1,11 @@
 #include "save.hpp"
+#include "perf.hpp"
+#include "Recorder.hpp"
+#include <array>
 #include <SDL2/SDL_error.h>
+#include <SDL2/SDL_stdinc.h>
 #include <nwge/common/array.hpp>
 #include <nwge/console.hpp>
-#include <nwge/json/builder.hpp>
 #include <nwge/json/Schema.hpp>
 
 using namespace nwge;
@@ -64,7 +67,12 @@ bool SavefileV2::load(data::RW &file) {
     lubeTier = s16(*maybeLubeTier);
   }
 
-  auto maybeGravityTier = root->expectNumberField("GravityTier"_sv);
+  // saves were always written with `gravityTier`, but used to be loaded as
+  // `GravityTier`, so accept both
+  auto maybeGravityTier = root->expectNumberField("gravityTier"_sv);
+  if(!maybeGravityTier.present()) {
+    maybeGravityTier = root->expectNumberField("GravityTier"_sv);
+  }
   if(maybeGravityTier.present()) {
     gravityTier = s16(*maybeGravityTier);
   }
@@ -79,30 +87,346 @@ bool SavefileV2::load(data::RW &file) {
     oxyTier = s16(*maybeOxyTier);
   }
 
+  loaded = true;
+  return true;
+}
+
+namespace {
+
+/* header layout: see `SavefileV3` */
+constexpr usize
+  cHeaderSize = 32,
+  cEntrySize = 12;
+
+constexpr u32
+  cFNVOffset = 0x811C9DC5,
+  cFNVPrime = 0x01000193;
+
+u32 fnv1a(const char *data, usize size) {
+  u32 hash = cFNVOffset;
+  for(usize i = 0; i < size; ++i) {
+    hash ^= u8(data[i]);
+    hash *= cFNVPrime;
+  }
+  return hash;
+}
+
+class FieldReader {
+public:
+  FieldReader(const char *data)
+    : mData(data)
+  {}
+
+  template<typename T>
+  T read() {
+    T value;
+    SDL_memcpy(&value, mData + mPos, sizeof(T));
+    mPos += sizeof(T);
+    return value;
+  }
+
+private:
+  const char *mData;
+  usize mPos = 0;
+};
+
+class FieldWriter {
+public:
+  FieldWriter(char *data)
+    : mData(data)
+  {}
+
+  template<typename T>
+  void write(T value) {
+    SDL_memcpy(mData + mPos, &value, sizeof(T));
+    mPos += sizeof(T);
+  }
+
+  [[nodiscard]]
+  inline usize pos() const {
+    return mPos;
+  }
+
+private:
+  char *mData;
+  usize mPos = 0;
+};
+
+} // namespace
+
+bool SavefileV3::load(data::RW &file) {
+  s64 size = file.size();
+  if(size <= 0) {
+    return true;
+  }
+  if(size != s64(cHeaderSize)) {
+    console::error("Could not load save file: Expected {} bytes, got {}.",
+      cHeaderSize, size);
+    return true;
+  }
+
+  ScratchArray<char> raw{cHeaderSize};
+  if(!file.read(raw.view())) {
+    console::error("Could not load save file: {}", SDL_GetError());
+    return true;
+  }
+
+  FieldReader reader{&raw[0]};
+  if(reader.read<u32>() != cMagic) {
+    console::error("Could not load save file: Not a save file.");
+    return true;
+  }
+  auto version = reader.read<u16>();
+  if(version != cVersion) {
+    console::error("Could not load save file: Unknown version {}.", version);
+    return true;
+  }
+  reader.read<u16>(); // reserved
+  auto readGeneration = reader.read<u32>();
+  auto readScore = reader.read<s32>();
+  auto readLubeTier = reader.read<s16>();
+  auto readGravityTier = reader.read<s16>();
+  auto readPrestige = reader.read<s16>();
+  auto readOxyTier = reader.read<s16>();
+  auto readJournalSeq = reader.read<u32>();
+  auto checksum = reader.read<u32>();
+  if(checksum != fnv1a(&raw[0], cHeaderSize - sizeof(u32))) {
+    console::error("Could not load save file: Checksum mismatch.");
+    return true;
+  }
+
+  generation = readGeneration;
+  score = readScore;
+  lubeTier = readLubeTier;
+  gravityTier = readGravityTier;
+  prestige = readPrestige;
+  oxyTier = readOxyTier;
+  journalSeq = readJournalSeq;
+  loaded = true;
   return true;
 }
 
-bool SavefileV2::save(data::RW &file) const {
-  json::ObjectBuilder root;
-  root.set("score"_sv, f64(score));
-  root.set("lubeTier"_sv, f64(lubeTier));
-  root.set("gravityTier"_sv, f64(gravityTier));
-  root.set("prestige"_sv, f64(prestige));
-  root.set("oxyTier"_sv, f64(oxyTier));
-  return file.write(json::encode(root.finish()).view());
+bool SavefileV3::save(data::RW &file) const {
+  SBS_PERF_SCOPE("save header");
+  std::array<char, cHeaderSize> raw{};
+  FieldWriter writer{raw.data()};
+  writer.write(cMagic);
+  writer.write(cVersion);
+  writer.write(u16(0)); // reserved
+  writer.write(generation);
+  writer.write(score);
+  writer.write(lubeTier);
+  writer.write(gravityTier);
+  writer.write(prestige);
+  writer.write(oxyTier);
+  writer.write(journalSeq);
+  writer.write(fnv1a(raw.data(), writer.pos()));
+  return file.write(StringView{raw.data(), raw.size()});
 }
 
-bool Savefile::save(data::RW &file) {
-  dirty = false;
-  if(v1.loaded) {
-    v2.score = v1.score;
-    v2.lubeTier = v1.lubeTier;
-    v2.gravityTier = v1.gravityTier;
-    v2.prestige = v1.prestige;
-    v2.oxyTier = v1.oxyTier;
-    v1.loaded = false;
-  }
-  return v2.save(file);
+bool ScoreJournal::load(data::RW &file) {
+  count = 0;
+  s64 size = file.size();
+  if(size <= 0) {
+    return true;
+  }
+
+  ScratchArray<char> raw{usize(size)};
+  if(!file.read(raw.view())) {
+    console::error("Could not load score journal: {}", SDL_GetError());
+    return true;
+  }
+
+  // a torn rewrite can leave any entry damaged, only the ones before the
+  // first bad one are trusted
+  const usize available = SDL_min(usize(size) / cEntrySize, cCapacity);
+  for(usize i = 0; i < available; ++i) {
+    const char *data = &raw[i * cEntrySize];
+    FieldReader reader{data};
+    Entry entry{};
+    entry.seq = reader.read<u32>();
+    entry.delta = reader.read<s32>();
+    auto check = reader.read<u32>();
+    if(check != fnv1a(data, cEntrySize - sizeof(u32))
+    || (count > 0 && entry.seq <= entries[count - 1].seq)) {
+      console::note("Dropped {} damaged score journal entries.",
+        usize(size) / cEntrySize - i);
+      break;
+    }
+    entries[count++] = entry;
+  }
+  return true;
+}
+
+bool ScoreJournal::save(data::RW &file) const {
+  SBS_PERF_SCOPE("save journal");
+  std::array<char, cCapacity * cEntrySize> raw{};
+  for(usize i = 0; i < count; ++i) {
+    char *data = &raw[i * cEntrySize];
+    FieldWriter writer{data};
+    writer.write(entries[i].seq);
+    writer.write(entries[i].delta);
+    writer.write(fnv1a(data, writer.pos()));
+  }
+  return file.write(StringView{raw.data(), count * cEntrySize});
+}
+
+void SaveScheduler::nqLoad(Savefile &save) {
+  mLoadedV1 = {};
+  mLoadedV2 = {};
+  mLoadedHeader = {};
+  mLoadedTmp = {};
+  mLoadedJournal = {};
+  mStore.nqLoad("save.bin"_sv, mLoadedHeader);
+  mStore.nqLoad("save.bin.tmp"_sv, mLoadedTmp);
+  mStore.nqLoad("save.jnl"_sv, mLoadedJournal);
+  mStore.nqLoad("save.json"_sv, mLoadedV2);
+  mStore.nqLoad("progress"_sv, mLoadedV1);
+}
+
+void SaveScheduler::resolve(Savefile &save) {
+  mSeq = 0;
+  mJournal = {};
+  const SavefileV3 *header = nullptr;
+  if(mLoadedHeader.loaded) {
+    header = &mLoadedHeader;
+  }
+  if(mLoadedTmp.loaded
+  && (header == nullptr || mLoadedTmp.generation > header->generation)) {
+    if(header == nullptr) {
+      console::note("save.bin is damaged, recovering from the last write.");
+    }
+    header = &mLoadedTmp;
+  }
+
+  if(header != nullptr) {
+    save.v3 = *header;
+    mSeq = header->journalSeq;
+    for(usize i = 0; i < mLoadedJournal.count; ++i) {
+      const auto &entry = mLoadedJournal.entries[i];
+      if(entry.seq <= header->journalSeq) {
+        continue;
+      }
+      save.v3.score += entry.delta;
+      mJournal.entries[mJournal.count++] = entry;
+      mSeq = entry.seq;
+    }
+    if(header != &mLoadedHeader) {
+      save.dirty = true;
+    }
+  } else if(mLoadedV2.loaded) {
+    save.v3.score = mLoadedV2.score;
+    save.v3.lubeTier = mLoadedV2.lubeTier;
+    save.v3.gravityTier = mLoadedV2.gravityTier;
+    save.v3.prestige = mLoadedV2.prestige;
+    save.v3.oxyTier = mLoadedV2.oxyTier;
+    save.dirty = true;
+    mDeleteLegacy = true;
+  } else if(mLoadedV1.loaded) {
+    save.v3.score = mLoadedV1.score;
+    save.v3.lubeTier = mLoadedV1.lubeTier;
+    save.v3.gravityTier = mLoadedV1.gravityTier;
+    save.v3.prestige = mLoadedV1.prestige;
+    save.v3.oxyTier = mLoadedV1.oxyTier;
+    save.dirty = true;
+    mDeleteLegacy = true;
+  }
+  recorder().save(save.v3);
+  mHeader.generation = save.v3.generation;
+
+  if(save.dirty) {
+    flush(save);
+  }
+}
+
+void SaveScheduler::markHeader(const Savefile &save) {
+  auto generation = mHeader.generation;
+  mHeader = save.v3;
+  mHeader.generation = generation;
+  if(!mHeaderPending && !mJournalPending) {
+    mTimer = 0.0f;
+  }
+  mHeaderPending = true;
+}
+
+void SaveScheduler::take(Savefile &save) {
+  if(save.dirty) {
+    markHeader(save);
+    ++mMarks;
+  } else if(save.scored != 0) {
+    if(mHeaderPending || mJournal.full()) {
+      // the header about to be written already includes the increment
+      if(!mHeaderPending) {
+        ++mCompactions;
+      }
+      markHeader(save);
+    } else {
+      if(!mJournalPending) {
+        mTimer = 0.0f;
+      }
+      mJournal.entries[mJournal.count++] = {++mSeq, save.scored};
+      mJournalPending = true;
+      ++mAppends;
+    }
+    ++mMarks;
+  }
+  save.dirty = false;
+  save.scored = 0;
+}
+
+void SaveScheduler::tick(f32 delta, Savefile &save) {
+  take(save);
+  if(!mHeaderPending && !mJournalPending) {
+    return;
+  }
+  mTimer += delta;
+  if(mTimer >= cFlushInterval) {
+    write();
+  }
+}
+
+void SaveScheduler::flush(Savefile &save) {
+  take(save);
+  if(mHeaderPending || mJournalPending) {
+    write();
+  }
+}
+
+void SaveScheduler::write() {
+  if(!recorder().writesSaves()) {
+    // a replay must not clobber the save of whoever is watching it
+    mHeaderPending = false;
+    mJournalPending = false;
+    mTimer = 0.0f;
+    return;
+  }
+  if(mHeaderPending) {
+    // compaction: the header absorbs every journal entry so far
+    ++mHeader.generation;
+    mHeader.journalSeq = mSeq;
+    mJournal.count = 0;
+    mStore.nqSave("save.bin.tmp"_sv, mHeader);
+    mStore.nqSave("save.bin"_sv, mHeader);
+    mStore.nqSave("save.jnl"_sv, mJournal);
+    if(mDeleteLegacy) {
+      mStore.nqDelete("save.json"_sv);
+      mStore.nqDelete("save.json.tmp"_sv);
+      mStore.nqDelete("progress"_sv);
+      mDeleteLegacy = false;
+    }
+  } else {
+    mStore.nqSave("save.jnl"_sv, mJournal);
+  }
+  mHeaderPending = false;
+  mJournalPending = false;
+  mTimer = 0.0f;
+  ++mWrites;
+}
+SaveScheduler &saveScheduler() {
+  // leaked for the same reason as the asset cache: queued writes must stay
+  // valid until the engine has drained them
+  static auto *sScheduler = new SaveScheduler;
+  return *sScheduler;
 }
 
 } // namespace sbs
@@ -6,12 +6,15 @@ save.hpp
 Savefile definitions
 */
 
+#include <array>
 #include <nwge/common/def.h>
+#include <nwge/console/Command.hpp>
 #include <nwge/data/rw.hpp>
+#include <nwge/data/store.hpp>
 
 namespace sbs {
 
-/* old save file format from before 1.4 */
+/* old save file format from before 1.4, only ever loaded for migration */
 struct SavefileV1 {
   bool loaded = false;
   s32 score = 0;
@@ -23,24 +26,139 @@ struct SavefileV1 {
   bool load(nwge::data::RW &file);
 };
 
-/* new save file format from 1.4 onwards */
+/* JSON save file format from 1.4, only ever loaded for migration */
 struct SavefileV2 {
+  bool loaded = false; // set only when the file parsed completely
   s32 score = 0;
   s16 lubeTier = 0;
   s16 gravityTier = 0;
   s16 prestige = 0;
   s16 oxyTier = 0;
 
+  bool load(nwge::data::RW &file);
+};
+
+/*
+Current save file format: a fixed-layout little endian header (32 bytes),
+followed by a FNV-1a checksum of everything before it. Score increments made
+since the header was last written live in the `ScoreJournal`.
+*/
+struct SavefileV3 {
+  static constexpr u32 cMagic = 0x33534253; // "SBS3"
+  static constexpr u16 cVersion = 3;
+
+  bool loaded = false; // set only when the checksum matched
+  /* bumped on every header write, so the newer of two intact copies wins */
+  u32 generation = 0;
+  s32 score = 0;
+  s16 lubeTier = 0;
+  s16 gravityTier = 0;
+  s16 prestige = 0;
+  s16 oxyTier = 0;
+  /* sequence number of the last journal entry already folded into `score` */
+  u32 journalSeq = 0;
+
+  bool load(nwge::data::RW &file);
+  bool save(nwge::data::RW &file) const;
+};
+
+/*
+Log of score increments made since the last header write. The store has no
+append, so every save rewrites the whole file & a torn write can damage any
+entry; each entry carries its own checksum, and loading keeps the intact
+entries up to the first damaged one. Since the header already holds the
+score up to `journalSeq`, at most the increments since the last header are
+lost. Once full, the journal is compacted into a fresh header.
+*/
+struct ScoreJournal {
+  static constexpr usize cCapacity = 64;
+
+  struct Entry {
+    u32 seq;
+    s32 delta;
+  };
+
+  std::array<Entry, cCapacity> entries{};
+  usize count = 0;
+
+  [[nodiscard]]
+  inline bool full() const {
+    return count == cCapacity;
+  }
+
   bool load(nwge::data::RW &file);
   bool save(nwge::data::RW &file) const;
 };
 
 struct Savefile {
+  /* tiers, prestige or the score were set outright, picked up by the next
+     SaveScheduler::tick as a full header write */
   bool dirty = false;
-  SavefileV1 v1;
-  SavefileV2 v2;
+  /* score gained since the last SaveScheduler::tick, journaled */
+  s32 scored = 0;
+  SavefileV3 v3;
+
+  inline void addScore(s32 delta) {
+    v3.score += delta;
+    scored += delta;
+  }
+};
+
+/*
+Coalesces save requests and writes them out at most once per flush interval.
+Score increments become journal appends, anything else rewrites the header.
+Each header write goes to `save.bin.tmp` first and only then to `save.bin`,
+so a crash in the middle of a write always leaves one intact copy behind.
+*/
+class SaveScheduler {
+public:
+  static constexpr f32 cFlushInterval = 2.0f;
+
+  /* Enqueues loads of every save file, including older formats. */
+  void nqLoad(Savefile &save);
+  /* Picks the intact copy, replays the journal & migrates older formats,
+     call from `init`. */
+  void resolve(Savefile &save);
+  /* Picks up changes to the save and writes once the interval has passed. */
+  void tick(f32 delta, Savefile &save);
+  /* Writes any pending changes right away, call when leaving a state. */
+  void flush(Savefile &save);
+
+private:
+  nwge::data::Store mStore;
+  /* copies of the save being written, so queued writes never reference a
+     state which has since been destroyed */
+  SavefileV3 mHeader;
+  ScoreJournal mJournal;
+  u32 mSeq = 0;
+  bool mHeaderPending = false;
+  bool mJournalPending = false;
+  bool mDeleteLegacy = false;
+  f32 mTimer = 0.0f;
 
-  bool save(nwge::data::RW &file);
+  /* copies read by `nqLoad`, consumed by `resolve` */
+  SavefileV1 mLoadedV1;
+  SavefileV2 mLoadedV2;
+  SavefileV3 mLoadedHeader;
+  SavefileV3 mLoadedTmp;
+  ScoreJournal mLoadedJournal;
+
+  u32 mMarks = 0;
+  u32 mAppends = 0;
+  u32 mWrites = 0;
+  u32 mCompactions = 0;
+
+  void take(Savefile &save);
+  void markHeader(const Savefile &save);
+  void write();
+
+  nwge::console::Command mStatsCommand{"sbs.saveStats", [this]{
+    nwge::console::print("{} save requests, {} journal appends, {} writes, {} compactions",
+      mMarks, mAppends, mWrites, mCompactions);
+  }};
 };
 
+/* The process-wide save scheduler. */
+SaveScheduler &saveScheduler();
+
 } // namespace sbs
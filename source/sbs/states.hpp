@@ -4,6 +4,7 @@ states.hpp
 Functions for different states of the game.
 */
 
+#include "assets.hpp"
 #include "config.hpp"
 #include "Music.hpp"
 #include "save.hpp"
@@ -14,12 +15,18 @@ Functions for different states of the game.
 namespace sbs {
 
 nwge::State *getWarningState();
-nwge::State *getIntroState(nwge::render::Texture &&logoTexture, Music &&music);
+nwge::State *getIntroState(Music &&music);
 nwge::State *getMenuState(Music &&music);
 nwge::State *getExtrasState(Music &&music);
 nwge::State *getShitState(Music &&music);
 nwge::State *getEndState();
 
+/* Enqueue the cached assets of a state ahead of time from another state's
+   loader, see the prefetch functions on `AssetLoader`. */
+void prefetchMenuState(AssetLoader &assets);
+void prefetchExtrasState(AssetLoader &assets);
+void prefetchShitState(AssetLoader &assets);
+
 struct StoreData {
   Savefile &save;
   Config &config;
@@ -29,7 +36,7 @@ struct StoreData {
   nwge::audio::Buffer &brokeSound;
 
   nwge::render::Font &font;
-  nwge::render::Texture &icons;
+  const Sprite &icons;
 };
 
 nwge::SubState *getStoreSubState(StoreData data);
@@ -6,6 +6,7 @@ ui.hpp
 Common UI definitions
 */
 
+#include "assets.hpp"
 #include <nwge/common/def.h>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/Font.hpp>
@@ -51,4 +52,14 @@ inline void drawTextWithShadow(
   font.draw(text, pos, height);
 }
 
+/* `render::rect` for sprites, `uvPos` & `uvSize` are relative to the sprite. */
+inline void drawSprite(
+  glm::vec3 pos, glm::vec2 size,
+  const Sprite &sprite,
+  glm::vec2 uvPos = {0, 0}, glm::vec2 uvSize = {1, 1}
+) {
+  nwge::render::rect(pos, size, *sprite.texture,
+    {sprite.mapPos(uvPos), sprite.mapSize(uvSize)});
+}
+
 } // namespace sbs
\ No newline at end of file
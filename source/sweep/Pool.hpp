@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+Pool.hpp
+--------
+Work-stealing thread pool for the balance sweep
+*/
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <nwge/common/def.h>
+#include <thread>
+#include <vector>
+
+namespace sweep {
+
+/*
+Runs a fixed set of independent tasks on every core. Each worker starts out
+with a contiguous slice of the tasks and works through it front to back;
+once its own queue is empty it steals from the back of the others, so slow
+slices (e.g. settings which score more often) do not hold up the sweep.
+*/
+class Pool {
+public:
+  using Task = std::function<void(usize task, usize worker)>;
+
+  Pool(usize threads = 0)
+    : mThreads(threads == 0
+        ? std::max<usize>(1, std::thread::hardware_concurrency())
+        : threads)
+  {}
+
+  [[nodiscard]]
+  inline usize threads() const {
+    return mThreads;
+  }
+
+  /* Runs tasks `0..count` & returns once all of them have finished. */
+  void run(usize count, const Task &task) {
+    std::vector<std::unique_ptr<Queue>> queues;
+    queues.reserve(mThreads);
+    for(usize i = 0; i < mThreads; ++i) {
+      auto &queue = *queues.emplace_back(std::make_unique<Queue>());
+      const usize begin = count * i / mThreads;
+      const usize end = count * (i + 1) / mThreads;
+      for(usize idx = begin; idx < end; ++idx) {
+        queue.tasks.push_back(idx);
+      }
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(mThreads);
+    for(usize worker = 0; worker < mThreads; ++worker) {
+      workers.emplace_back([&queues, &task, worker]{
+        usize idx;
+        while(take(queues, worker, idx)) {
+          task(idx, worker);
+        }
+      });
+    }
+    for(auto &thread: workers) {
+      thread.join();
+    }
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<usize> tasks;
+  };
+
+  usize mThreads;
+
+  static bool take(std::vector<std::unique_ptr<Queue>> &queues, usize worker, usize &out) {
+    {
+      auto &own = *queues[worker];
+      std::lock_guard lock{own.mutex};
+      if(!own.tasks.empty()) {
+        out = own.tasks.front();
+        own.tasks.pop_front();
+        return true;
+      }
+    }
+    // tasks never spawn more tasks, so one empty pass means we're done
+    for(usize i = 1; i < queues.size(); ++i) {
+      auto &victim = *queues[(worker + i) % queues.size()];
+      std::lock_guard lock{victim.mutex};
+      if(!victim.tasks.empty()) {
+        out = victim.tasks.back();
+        victim.tasks.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+} // namespace sweep
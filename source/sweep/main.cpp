@@ -0,0 +1,331 @@
+#include "Pool.hpp"
+#include "../sbs/config.hpp"
+#include "../sbs/Sim.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+sweep
+-----
+Monte Carlo balance sweep. Varies the tuning values of the config across a
+grid, plays scripted click sessions against each setting on the headless
+simulation & prints a CSV of bricks per minute & how long it takes to afford
+each store item.
+
+  sweep [options] [cfg.json]
+
+  --steps N      grid points per parameter (default 3)
+  --span F       relative distance of the outermost points (default 0.25)
+  --sessions N   sessions per setting (default 64)
+  --minutes F    length of each session (default 5)
+  --cps F        clicks per second of the scripted player (default 8)
+  --tiers L,G,O  lube, gravity & oxy tiers to play with (default 0,0,0)
+  --seed N       base seed, every session derives its own from it
+  --threads N    worker threads (default: every core)
+*/
+
+using namespace nwge;
+using sbs::Config;
+using sbs::Rng;
+using sbs::SavefileV3;
+using sbs::Sim;
+
+namespace {
+
+struct Param {
+  const char *name;
+  f32 &(*field)(Config &config);
+};
+
+const Param cParams[] = {
+  {"lube.base", [](Config &c) -> f32& { return c.lube.base; }},
+  {"lube.upgrade", [](Config &c) -> f32& { return c.lube.upgrade; }},
+  {"gravity.base", [](Config &c) -> f32& { return c.gravity.base; }},
+  {"gravity.upgrade", [](Config &c) -> f32& { return c.gravity.upgrade; }},
+  {"gravity.threshold", [](Config &c) -> f32& { return c.gravity.threshold; }},
+  {"oxy.regenFast", [](Config &c) -> f32& { return c.oxy.regenFast; }},
+  {"oxy.regenSlow", [](Config &c) -> f32& { return c.oxy.regenSlow; }},
+  {"oxy.drain", [](Config &c) -> f32& { return c.oxy.drain; }},
+  {"oxy.min", [](Config &c) -> f32& { return c.oxy.min; }},
+};
+constexpr usize cParamCount = sizeof(cParams) / sizeof(cParams[0]);
+
+/* sessions simulated in lockstep by one task */
+constexpr usize cBatch = 8;
+
+struct Options {
+  usize steps = 3;
+  f32 span = 0.25f;
+  usize sessions = 64;
+  f32 minutes = 5.0f;
+  f32 cps = 8.0f;
+  SavefileV3 save;
+  u64 seed = 0x5B5202A;
+  usize threads = 0;
+  const char *config = "source/data/cfg.json";
+};
+
+struct Price {
+  s32 price;
+  StringView name;
+};
+
+/* Accumulated over the sessions of one task. */
+struct TaskResult {
+  u64 bricks = 0;
+  usize sessions = 0;
+  std::vector<f64> affordTime;
+  std::vector<u32> afforded;
+};
+
+std::string readFile(const char *path) {
+  std::ifstream file{path, std::ios::binary};
+  if(!file) {
+    return {};
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+bool parseOptions(s32 argc, CStr *argv, Options &out) {
+  for(s32 i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto want = [&](const char *name) {
+      if(std::strcmp(arg, name) != 0) {
+        return false;
+      }
+      if(value == nullptr) {
+        std::fprintf(stderr, "%s expects a value\n", name);
+        std::exit(1);
+      }
+      ++i;
+      return true;
+    };
+    if(want("--steps")) {
+      out.steps = std::max<usize>(1, std::strtoull(value, nullptr, 10));
+    } else if(want("--span")) {
+      out.span = std::strtof(value, nullptr);
+    } else if(want("--sessions")) {
+      out.sessions = std::max<usize>(1, std::strtoull(value, nullptr, 10));
+    } else if(want("--minutes")) {
+      out.minutes = std::strtof(value, nullptr);
+    } else if(want("--cps")) {
+      out.cps = std::strtof(value, nullptr);
+    } else if(want("--tiers")) {
+      s32 lube = 0, gravity = 0, oxy = 0;
+      if(std::sscanf(value, "%d,%d,%d", &lube, &gravity, &oxy) != 3) {
+        std::fprintf(stderr, "--tiers expects L,G,O\n");
+        return false;
+      }
+      out.save.lubeTier = s16(lube);
+      out.save.gravityTier = s16(gravity);
+      out.save.oxyTier = s16(oxy);
+    } else if(want("--seed")) {
+      out.seed = std::strtoull(value, nullptr, 0);
+    } else if(want("--threads")) {
+      out.threads = std::strtoull(value, nullptr, 10);
+    } else if(arg[0] == '-') {
+      std::fprintf(stderr, "unknown option %s\n", arg);
+      return false;
+    } else {
+      out.config = arg;
+    }
+  }
+  if(out.cps <= 0 || out.minutes <= 0) {
+    std::fprintf(stderr, "--cps & --minutes must be positive\n");
+    return false;
+  }
+  return true;
+}
+
+/* Only the sections the simulation reads. `Config` itself owns its strings
+   and store, which the workers have no use for. */
+void copyTuning(Config &to, const Config &from) {
+  to.lube = from.lube;
+  to.gravity = from.gravity;
+  to.oxy = from.oxy;
+  to.brick = from.brick;
+  to.water = from.water;
+}
+
+/* Writes grid point `setting` of every parameter into `config`. */
+void applySetting(Config &config, const Config &base, const Options &opts, usize setting) {
+  copyTuning(config, base);
+  if(opts.steps == 1) {
+    return;
+  }
+  for(const auto &param: cParams) {
+    usize step = setting % opts.steps;
+    setting /= opts.steps;
+    f32 t = f32(step) / f32(opts.steps - 1) * 2.0f - 1.0f;
+    param.field(config) *= 1.0f + t * opts.span;
+  }
+}
+
+u64 settingCount(const Options &opts) {
+  u64 count = 1;
+  for(usize i = 0; i < cParamCount; ++i) {
+    count *= opts.steps;
+  }
+  return count;
+}
+
+void simulate(
+  const Config &config, const Options &opts,
+  const std::vector<Price> &prices,
+  u64 seed, usize lanes,
+  TaskResult &out
+) {
+  Sim sims[cBatch];
+  Rng players[cBatch];
+  f32 nextClick[cBatch];
+  s32 score[cBatch];
+  usize reached[cBatch];
+
+  for(usize lane = 0; lane < lanes; ++lane) {
+    sims[lane] = Sim{seed + 2*lane};
+    sims[lane].recalculate(config, opts.save);
+    players[lane].reseed(seed + 2*lane + 1);
+    nextClick[lane] = 0.0f;
+    score[lane] = 0;
+    reached[lane] = 0;
+  }
+
+  const f32 interval = 1.0f / opts.cps;
+  const u64 steps = u64(opts.minutes * 60.0f / Sim::cFixedStep);
+  for(u64 step = 0; step < steps; ++step) {
+    for(usize lane = 0; lane < lanes; ++lane) {
+      auto &sim = sims[lane];
+      nextClick[lane] -= Sim::cFixedStep;
+      if(nextClick[lane] <= 0) {
+        sim.push(config);
+        // human-ish jitter of +-50% around the click interval
+        nextClick[lane] += interval * (0.5f + players[lane].unit());
+      }
+      if(!sim.tick(Sim::cFixedStep, config, opts.save).scored) {
+        continue;
+      }
+      ++score[lane];
+      // prices are sorted, so everything up to the first unaffordable one
+      // has now been reached
+      while(reached[lane] < prices.size() && prices[reached[lane]].price <= score[lane]) {
+        out.affordTime[reached[lane]] += sim.timer;
+        ++out.afforded[reached[lane]];
+        ++reached[lane];
+      }
+    }
+  }
+
+  for(usize lane = 0; lane < lanes; ++lane) {
+    out.bricks += sims[lane].bricks;
+  }
+  out.sessions += lanes;
+}
+
+} // namespace
+
+s32 main(s32 argc, CStr *argv) {
+  Options opts;
+  if(!parseOptions(argc, argv, opts)) {
+    return 1;
+  }
+
+  auto raw = readFile(opts.config);
+  Config base;
+  if(raw.empty() || !base.loadMemory(StringView{raw.data(), raw.size()})) {
+    std::fprintf(stderr, "could not load %s\n", opts.config);
+    return 1;
+  }
+
+  std::vector<Price> prices;
+  for(const auto &item: base.store) {
+    prices.push_back({item.price, item.name});
+  }
+  std::stable_sort(prices.begin(), prices.end(), [](const Price &a, const Price &b){
+    return a.price < b.price;
+  });
+
+  const u64 settings = settingCount(opts);
+  const u64 batchesPerSetting = (opts.sessions + cBatch - 1) / cBatch;
+  const u64 tasks = settings * batchesPerSetting;
+
+  sweep::Pool pool{opts.threads};
+  std::vector<Config> configs(pool.threads());
+  std::vector<TaskResult> results(tasks);
+  for(auto &result: results) {
+    result.affordTime.resize(prices.size());
+    result.afforded.resize(prices.size());
+  }
+
+  std::fprintf(stderr, "%llu settings x %zu sessions of %g min on %zu threads\n",
+    (unsigned long long)settings, opts.sessions, f64(opts.minutes), pool.threads());
+  auto start = std::chrono::steady_clock::now();
+
+  pool.run(tasks, [&](usize task, usize worker){
+    const u64 setting = task / batchesPerSetting;
+    const u64 batch = task % batchesPerSetting;
+    const usize first = batch * cBatch;
+    const usize lanes = std::min<usize>(cBatch, opts.sessions - first);
+    auto &config = configs[worker];
+    applySetting(config, base, opts, setting);
+    const u64 seed = opts.seed + (setting * opts.sessions + first) * 2;
+    simulate(config, opts, prices, seed, lanes, results[task]);
+  });
+
+  std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+  const f64 ticks = f64(settings) * f64(opts.sessions)
+    * f64(u64(opts.minutes * 60.0f / Sim::cFixedStep));
+  std::fprintf(stderr, "done in %.2fs, %.1fM ticks/s\n",
+    elapsed.count(), ticks / elapsed.count() / 1e6);
+
+  for(const auto &param: cParams) {
+    std::printf("%s,", param.name);
+  }
+  std::printf("bricksPerMinute");
+  for(const auto &price: prices) {
+    std::printf(",%.*s (%d) s,%.*s (%d) %%",
+      s32(price.name.size()), price.name.begin(), price.price,
+      s32(price.name.size()), price.name.begin(), price.price);
+  }
+  std::printf("\n");
+
+  Config config;
+  for(u64 setting = 0; setting < settings; ++setting) {
+    TaskResult total;
+    total.affordTime.resize(prices.size());
+    total.afforded.resize(prices.size());
+    for(u64 batch = 0; batch < batchesPerSetting; ++batch) {
+      const auto &result = results[setting * batchesPerSetting + batch];
+      total.bricks += result.bricks;
+      total.sessions += result.sessions;
+      for(usize i = 0; i < prices.size(); ++i) {
+        total.affordTime[i] += result.affordTime[i];
+        total.afforded[i] += result.afforded[i];
+      }
+    }
+
+    applySetting(config, base, opts, setting);
+    for(const auto &param: cParams) {
+      std::printf("%g,", f64(param.field(config)));
+    }
+    std::printf("%.3f", f64(total.bricks) / f64(total.sessions) / f64(opts.minutes));
+    for(usize i = 0; i < prices.size(); ++i) {
+      if(total.afforded[i] > 0) {
+        std::printf(",%.1f", total.affordTime[i] / f64(total.afforded[i]));
+      } else {
+        std::printf(",");
+      }
+      std::printf(",%.1f", 100.0 * f64(total.afforded[i]) / f64(total.sessions));
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,9 @@
+/*
+sbs.cpp
+-------
+bip builds every target from its own directory, so the bits of the game the
+sweep needs are compiled in from here.
+*/
+
+#include "../sbs/config.cpp"
+#include "../sbs/perf.cpp"
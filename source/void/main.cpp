@@ -1,14 +1,18 @@
+#include "../sbs/BrickField.hpp"
 #include <nwge/engine.hpp>
 #include <nwge/bind.hpp>
+#include <nwge/console/Command.hpp>
 #include <nwge/data/bundle.hpp>
 #include <nwge/render/AspectRatio.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/mat.hpp>
 #include <nwge/render/window.hpp>
 #include <nwge/render/Texture.hpp>
-#include <random>
+#include <boost/lexical_cast.hpp>
+#include <SDL2/SDL_timer.h>
 
 using namespace nwge;
+using sbs::BrickField;
 
 class Void: public State {
 public:
@@ -20,24 +24,26 @@ public:
   }
 
   bool init() override {
-    for(auto &brick: mBricks) {
-      brick.regenerate(true);
-    }
+    mBricks.populate();
     return true;
   }
 
   bool tick(f32 delta) override {
-    for(auto &brick: mBricks) {
-      brick.update(delta);
+    u64 start = SDL_GetPerformanceCounter();
+    if(mStats.frames == 0) {
+      mStats.since = start;
     }
+    ++mStats.frames;
+    mBricks.update(delta);
+    mStats.update += SDL_GetPerformanceCounter() - start;
     return true;
   }
 
   void render() const override {
+    u64 start = SDL_GetPerformanceCounter();
     render::clear({0, 0, 0});
-    for(const auto &brick: mBricks) {
-      brick.render(mBrickTexture, m1x1);
-    }
+    mBricks.render(mBrickTexture, m1x1);
+    mStats.render += SDL_GetPerformanceCounter() - start;
   }
 
 private:
@@ -48,87 +54,57 @@ private:
   data::Bundle mBundle;
   render::AspectRatio m1x1{1, 1};
 
-  static constexpr s32 cBrickCount = 100;
-
-  static constexpr f32
-    cBrickSpeed = 0.2f,
-    cBrickW = 0.08f,
-    cBrickH = 0.16f,
-    cBrickMinDistance = 0.1f,
-    cBrickMaxDistance = 1.0f,
-    cBrickMinX = -0.05f,
-    cBrickMaxX = 1.05f,
-    cBrickMinY = -0.3f,
-    cBrickMaxStartY = -0.1f,
-    cBrickDeathY = 1.1f,
-    cBrickBaseZ = 0.53f,
-    cBrickZIncrement = 0.001f,
-    cBrickMinRotSpeed = -0.2f,
-    cBrickMaxRotSpeed = 0.2f;
+  BrickField mBricks{{
+    .count = 100,
+    .speed = 0.2f,
+    .width = 0.08f,
+    .height = 0.16f,
+    .baseZ = 0.53f,
+    .deStretch = BrickField::DeStretchSize,
+  }};
 
   render::Texture mBrickTexture;
 
-  struct Brick {
-    glm::vec3 pos;
-    f32 rotation;
-    f32 rotationSpeed;
-
-    void regenerate(bool onScreen) {
-      static std::mt19937 sEng{std::random_device{}()};
-      static std::uniform_real_distribution<f32>
-        sDistanceDis{cBrickMinDistance, cBrickMaxDistance};
-      static std::uniform_real_distribution<f32>
-        sRotDis{-M_PI, M_PI};
-      static std::uniform_real_distribution<f32>
-        sXDis{cBrickMinX, cBrickMaxX};
-      static std::uniform_real_distribution<f32>
-        sYDis{cBrickMinY, cBrickMaxStartY};
-      static std::uniform_real_distribution<f32>
-        sOnScreenYDis{cBrickMinY, cBrickDeathY};
-      static std::uniform_real_distribution<f32>
-        sRotSpeedDis{cBrickMinRotSpeed, cBrickMaxRotSpeed};
-
-      pos.x = sXDis(sEng);
-      if(onScreen) {
-        pos.y = sOnScreenYDis(sEng);
-      } else {
-        pos.y = sYDis(sEng);
-      }
-      pos.z = sDistanceDis(sEng);
-      rotation = sRotDis(sEng);
-      rotationSpeed = sRotSpeedDis(sEng);
-    }
-
-    void update(f32 delta) {
-      pos.y += cBrickSpeed * delta * pos.z;
-
-      if(pos.y >= cBrickDeathY) {
-        regenerate(false);
+  /* Times since the last `void.perf`, in performance counter ticks. `render`
+     is the CPU time spent issuing the draws, `frame` is the wall time from
+     the first tick on, which includes waiting on the GPU & vsync. */
+  struct Stats {
+    u32 frames = 0;
+    u64 since = 0;
+    u64 update = 0;
+    u64 render = 0;
+  };
+  mutable Stats mStats;
+
+  console::Command mBricksCommand{"void.bricks", [this](auto &args){
+    if(args.size() == 1) {
+      try {
+        mBricks.resize(boost::lexical_cast<s32>(args[0].begin(), args[0].size()));
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
         return;
       }
-
-      rotation += rotationSpeed * delta;
     }
-
-    void render(const render::Texture &texture, const render::AspectRatio &deStretch) const {
-      render::color({pos.z, pos.z, pos.z});
-      render::mat::push();
-      render::mat::translate({
-        pos.x, pos.y,
-        cBrickBaseZ - pos.z * cBrickZIncrement});
-      render::mat::translate({cBrickW/2.0f, cBrickH/2.0f, 0.0f});
-      render::mat::scale({deStretch.size({1, 1}), 1});
-      render::mat::rotate(rotation, {0, 0, 1});
-      render::mat::translate({-cBrickW/2.0f, -cBrickH/2.0f, 0.0f});
-      render::mat::scale({
-        cBrickW * pos.z * pos.z,
-        cBrickH * pos.z * pos.z,
-        1});
-      render::rect({0, 0, 0}, {1, 1}, texture);
-      render::mat::pop();
+    console::print("bricks: {} (max {})", mBricks.count(), BrickField::cMaxCount);
+  }};
+
+  /* `void.perf` reports the average frame since it last ran, so the cost of
+     `void.bricks` counts up to the max can be read off directly. */
+  console::Command mPerfCommand{"void.perf", [this]{
+    if(mStats.frames < 2) {
+      console::print("nothing drawn yet");
+      return;
     }
-  };
-  std::array<Brick, cBrickCount> mBricks{};
+    auto micros = [this](u64 ticks){
+      return f64(ticks) * 1e6 / f64(SDL_GetPerformanceFrequency()) / f64(mStats.frames);
+    };
+    f64 frame = micros(SDL_GetPerformanceCounter() - mStats.since);
+    console::print("{} bricks, per frame over {} frames: update {} us, "
+      "render {} us, frame {} us ({} fps)",
+      mBricks.count(), mStats.frames, micros(mStats.update),
+      micros(mStats.render), frame, 1e6 / frame);
+    mStats = {};
+  }};
 };
 
 s32 main([[maybe_unused]] s32 argc, [[maybe_unused]] CStr *argv) {